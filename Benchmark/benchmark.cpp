@@ -0,0 +1,299 @@
+#include "generators.h"
+
+#include "../circuits/src/circuit/circuit.h"
+#include "../circuits/src/circuit/factorization_cache.h"
+#include "../circuits/src/lingebra/kernels.h"
+#include "../circuits/src/settings.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+
+/* Runs the synthetic circuits with every solver path and prints one record per run.
+ * Usage: benchmark [--format json|csv] [--output <path>] [--filter <text>] [--steps <n>] [--quick] */
+
+struct Options {
+	bool csv = false;
+	fs::path output;
+	std::string filter;
+	size_t num_steps = 20000;
+	bool quick = false;
+};
+
+struct BenchmarkCase {
+	std::string name;
+	size_t size;
+	std::function<void(Circuit &, size_t num_steps)> build;
+};
+
+struct SolverPath {
+	std::string name;
+	size_t cache_budget_bytes;
+};
+
+struct Result {
+	std::string name;
+	size_t size;
+	std::string solver;
+	SolverStats stats;
+	size_t steps;
+	double build_ms;
+	double compile_ms;
+	double run_ms;
+	size_t cache_hits;
+	size_t cache_misses;
+	size_t cache_bytes;
+	size_t peak_rss_kib;
+};
+
+
+// Peak resident memory in KiB. On Linux the peak is reset before every run, so it belongs to that run,
+// elsewhere it is the peak of the whole process so far.
+static void reset_peak_memory() {
+#ifdef __linux__
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+#endif
+}
+
+static size_t peak_memory_kib() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize / 1024;
+#else
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.starts_with("VmHWM:")) return std::strtoull(line.c_str() + 6, nullptr, 10);
+	}
+#endif
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<size_t>(usage.ru_maxrss);
+#endif
+}
+
+static const char *isa_name(lingebra::kernels::Isa isa) {
+	switch (isa) {
+		case lingebra::kernels::Isa::avx512: return "avx512";
+		case lingebra::kernels::Isa::avx2: return "avx2";
+		default: return "scalar";
+	}
+}
+
+
+// the circuit reports its progress to std::cout, which would end up in the results
+class NullBuffer : public std::streambuf {
+protected:
+	int overflow(int c) override { return c; }
+};
+
+class SilenceCout {
+private:
+	NullBuffer null;
+	std::streambuf *previous;
+
+public:
+	SilenceCout() : previous(std::cout.rdbuf(&null)) {}
+	~SilenceCout() { std::cout.rdbuf(previous); }
+};
+
+
+static std::vector<BenchmarkCase> make_cases(bool quick) {
+	using namespace generators;
+
+	std::vector<BenchmarkCase> cases;
+
+	for (size_t n : quick ? std::vector<size_t>{ 10, 100 } : std::vector<size_t>{ 10, 100, 1000 }) {
+		cases.push_back({ "rc_ladder", n, [n](Circuit &c, size_t) { rc_ladder(c, n); } });
+	}
+	for (size_t w : quick ? std::vector<size_t>{ 4, 10 } : std::vector<size_t>{ 4, 10, 30 }) {
+		cases.push_back({ "rlc_mesh", w * w, [w](Circuit &c, size_t) { rlc_mesh(c, w, w); } });
+	}
+	for (size_t n : quick ? std::vector<size_t>{ 16, 64 } : std::vector<size_t>{ 16, 64, 256 }) {
+		// 4 groups switching every 50 steps and slower, 16 states
+		cases.push_back({ "switch_network", n, [n](Circuit &c, size_t num_steps) { switch_network(c, n, 4, 50, num_steps); } });
+	}
+	for (size_t n : quick ? std::vector<size_t>{ 100 } : std::vector<size_t>{ 100, 1000 }) {
+		cases.push_back({ "random_graph", n, [n](Circuit &c, size_t) { random_graph(c, n, 4, 1); } });
+	}
+
+	return cases;
+}
+
+static Result run_case(const BenchmarkCase &bench, const SolverPath &solver, size_t num_steps, const fs::path &export_path) {
+	using clock = std::chrono::steady_clock;
+	const auto ms_since = [](clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	};
+
+	SilenceCout silence;
+	reset_peak_memory();
+
+	auto start = clock::now();
+	Circuit circuit(1e-5, export_path);
+	circuit.set_factorization_cache_budget(solver.cache_budget_bytes);
+	bench.build(circuit, num_steps);
+	const double build_ms = ms_since(start);
+
+	start = clock::now();
+	circuit.compile();
+	const double compile_ms = ms_since(start);
+
+	start = clock::now();
+	circuit.run_for_steps(num_steps);
+	const double run_ms = ms_since(start);
+
+	const FactorizationCache &cache = circuit.get_factorization_cache();
+
+	return {
+		bench.name, bench.size, solver.name, circuit.get_solver_stats(), num_steps,
+		build_ms, compile_ms, run_ms,
+		cache.get_hits(), cache.get_misses(), cache.get_used_bytes(),
+		peak_memory_kib()
+	};
+}
+
+
+static void write_csv(std::ostream &out, const std::vector<Result> &results) {
+	out << "name,size,solver,rows,matrix_nnz,lu_nnz,lu_bytes,steps,build_ms,compile_ms,run_ms,steps_per_second,"
+		"factorizations,low_rank_updates,cache_hits,cache_misses,cache_bytes,peak_rss_kib\n";
+
+	for (const Result &r : results) {
+		out << std::format("{},{},{},{},{},{},{},{},{:.3f},{:.3f},{:.3f},{:.1f},{},{},{},{},{},{}\n",
+			r.name, r.size, r.solver, r.stats.num_rows, r.stats.matrix_nnz, r.stats.lu_nnz, r.stats.lu_bytes, r.steps,
+			r.build_ms, r.compile_ms, r.run_ms, r.steps * 1000.0 / r.run_ms,
+			r.stats.factorizations, r.stats.low_rank_updates, r.cache_hits, r.cache_misses, r.cache_bytes, r.peak_rss_kib
+		);
+	}
+}
+
+static void write_json(std::ostream &out, const std::vector<Result> &results) {
+	out << std::format("{{\n  \"version\": \"{}.{}.{}\",\n  \"isa\": \"{}\",\n  \"results\": [",
+		APP_VERSION_MAJOR, APP_VERSION_MINOR, APP_VERSION_PATCH, isa_name(lingebra::kernels::active_isa()));
+
+	for (size_t i = 0; i < results.size(); ++i) {
+		const Result &r = results[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << std::format(
+			"    {{\"name\": \"{}\", \"size\": {}, \"solver\": \"{}\", \"rows\": {}, \"matrix_nnz\": {}, \"lu_nnz\": {}, \"lu_bytes\": {}, "
+			"\"steps\": {}, \"build_ms\": {:.3f}, \"compile_ms\": {:.3f}, \"run_ms\": {:.3f}, \"steps_per_second\": {:.1f}, "
+			"\"factorizations\": {}, \"low_rank_updates\": {}, \"cache_hits\": {}, \"cache_misses\": {}, \"cache_bytes\": {}, "
+			"\"peak_rss_kib\": {}}}",
+			r.name, r.size, r.solver, r.stats.num_rows, r.stats.matrix_nnz, r.stats.lu_nnz, r.stats.lu_bytes,
+			r.steps, r.build_ms, r.compile_ms, r.run_ms, r.steps * 1000.0 / r.run_ms,
+			r.stats.factorizations, r.stats.low_rank_updates, r.cache_hits, r.cache_misses, r.cache_bytes, r.peak_rss_kib
+		);
+	}
+
+	out << "\n  ]\n}\n";
+}
+
+
+static bool parse_args(int argc, char *argv[], Options &options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string option(argv[i]);
+		const bool has_value = i + 1 < argc;
+
+		if (option == "--format" && has_value) {
+			const std::string format(argv[++i]);
+			if (format != "json" && format != "csv") return false;
+			options.csv = format == "csv";
+		}
+		else if (option == "--output" && has_value) {
+			options.output = argv[++i];
+		}
+		else if (option == "--filter" && has_value) {
+			options.filter = argv[++i];
+		}
+		else if (option == "--steps" && has_value) {
+			options.num_steps = std::strtoull(argv[++i], nullptr, 10);
+			if (options.num_steps == 0) return false;
+		}
+		else if (option == "--quick") {
+			options.quick = true;
+		}
+		else {
+			return false;
+		}
+	}
+
+	if (options.quick) options.num_steps = std::min<size_t>(options.num_steps, 2000);
+
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+	if (!parse_args(argc, argv, options)) {
+		std::cerr << "Usage: benchmark [--format json|csv] [--output <path>] [--filter <text>] [--steps <n>] [--quick]\n"
+			<< "  --filter selects the runs whose \"name/solver\" contains the text\n"
+			<< "  --quick  smaller circuits and at most 2000 steps\n";
+		return 1;
+	}
+
+	const std::vector<SolverPath> solvers = {
+		{ "cache", FactorizationCache::default_budget_bytes },
+		{ "low-rank", 0 },
+	};
+
+	// the circuit always creates its scope directories
+	const fs::path export_path = fs::temp_directory_path() / "simlogue-benchmark";
+
+	std::vector<Result> results;
+
+	try {
+		for (const BenchmarkCase &bench : make_cases(options.quick)) {
+			for (const SolverPath &solver : solvers) {
+				const std::string id = std::format("{}/{}", bench.name, solver.name);
+				if (!id.contains(options.filter)) continue;
+
+				std::cerr << std::format("{} ({})...", id, bench.size) << std::flush;
+				results.push_back(run_case(bench, solver, options.num_steps, export_path));
+				std::cerr << std::format(" {:.0f} steps/s\n", results.back().steps * 1000.0 / results.back().run_ms);
+			}
+		}
+	}
+	catch (const std::exception &e) {
+		std::cerr << "\n" << e.what() << "\n";
+		return 1;
+	}
+
+	fs::remove_all(export_path);
+
+	std::ofstream file;
+	if (!options.output.empty()) {
+		file.open(options.output);
+		if (!file) {
+			std::cerr << "Cannot write " << options.output << "\n";
+			return 1;
+		}
+	}
+	std::ostream &out = options.output.empty() ? std::cout : file;
+
+	if (options.csv) write_csv(out, results);
+	else write_json(out, results);
+
+	return 0;
+}
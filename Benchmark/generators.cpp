@@ -0,0 +1,123 @@
+#include "generators.h"
+
+#include "../circuits/src/circuit/circuit.h"
+#include "../circuits/src/circuit/parts/capacitor.h"
+#include "../circuits/src/circuit/parts/inductor.h"
+#include "../circuits/src/circuit/parts/resistor.h"
+#include "../circuits/src/circuit/parts/switch.h"
+#include "../circuits/src/circuit/parts/voltage_source.h"
+#include "../circuits/src/circuit/scalar.h"
+#include <format>
+#include <random>
+#include <vector>
+
+
+
+namespace generators {
+	// the capacitors to ground stand for the nodes, the pin is looked up again on every connect
+	// because connecting can merge the node of a stored pin away
+	static std::vector<Capacitor *> add_grounded_nodes(Circuit &circuit, size_t n, scalar capacitance) {
+		std::vector<Capacitor *> nodes(n);
+
+		for (size_t i = 0; i < n; ++i) {
+			nodes[i] = circuit.add_part<Capacitor>(std::format("C{}", i), capacitance);
+			circuit.connect(nodes[i]->pin(1), circuit.get_ground()->pin());
+		}
+
+		return nodes;
+	}
+
+	static void drive(Circuit &circuit, Capacitor *node) {
+		VoltageSource *source = circuit.add_part<VoltageSource>("V", 5.0);
+		Resistor *R = circuit.add_part<Resistor>("R_source", 100.0);
+
+		circuit.connect(source->pin(), R->pin(0));
+		circuit.connect(R->pin(1), node->pin(0));
+	}
+
+	static std::vector<Capacitor *> add_rc_ladder(Circuit &circuit, size_t n) {
+		const auto nodes = add_grounded_nodes(circuit, n, 100_n);
+
+		drive(circuit, nodes[0]);
+
+		for (size_t i = 1; i < n; ++i) {
+			Resistor *R = circuit.add_part<Resistor>(std::format("R{}", i), 1_k);
+			circuit.connect(nodes[i - 1]->pin(0), R->pin(0));
+			circuit.connect(R->pin(1), nodes[i]->pin(0));
+		}
+
+		return nodes;
+	}
+
+	void rc_ladder(Circuit &circuit, size_t n) {
+		add_rc_ladder(circuit, n);
+	}
+
+	void rlc_mesh(Circuit &circuit, size_t w, size_t h) {
+		const auto nodes = add_grounded_nodes(circuit, w * h, 1_u);
+
+		drive(circuit, nodes[0]);
+
+		for (size_t y = 0; y < h; ++y) {
+			for (size_t x = 0; x < w; ++x) {
+				const size_t i = y * w + x;
+
+				if (x + 1 < w) {
+					Resistor *R = circuit.add_part<Resistor>(std::format("R{}", i), 10.0);
+					circuit.connect(nodes[i]->pin(0), R->pin(0));
+					circuit.connect(R->pin(1), nodes[i + 1]->pin(0));
+				}
+				if (y + 1 < h) {
+					Inductor *L = circuit.add_part<Inductor>(std::format("L{}", i), 1_m);
+					circuit.connect(nodes[i]->pin(0), L->pin(0));
+					circuit.connect(L->pin(1), nodes[i + w]->pin(0));
+				}
+			}
+		}
+	}
+
+	void switch_network(Circuit &circuit, size_t n, size_t groups, size_t period, size_t num_steps) {
+		const auto nodes = add_rc_ladder(circuit, n);
+
+		for (size_t i = 0; i < n; ++i) {
+			Switch *S = circuit.add_part<Switch>(std::format("S{}", i));
+			Resistor *R = circuit.add_part<Resistor>(std::format("R_load{}", i), 10_k);
+
+			circuit.connect(nodes[i]->pin(0), S->pin(0));
+			circuit.connect(S->pin(1), R->pin(0));
+			circuit.connect(R->pin(1), circuit.get_ground()->pin());
+
+			const size_t toggle = period << (i % groups);
+			for (size_t step = toggle; step < num_steps; step += 2 * toggle) {
+				S->schedule_on(step * circuit.get_timestep());
+				S->schedule_off((step + toggle) * circuit.get_timestep());
+			}
+		}
+	}
+
+	void random_graph(Circuit &circuit, size_t n, size_t degree, uint32_t seed) {
+		const auto nodes = add_grounded_nodes(circuit, n, 100_n);
+
+		drive(circuit, nodes[0]);
+
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<size_t> pick(0, n - 1);
+
+		size_t id = 0;
+		const auto add_edge = [&](size_t a, size_t b) {
+			Resistor *R = circuit.add_part<Resistor>(std::format("R{}", id++), 1_k);
+			circuit.connect(nodes[a]->pin(0), R->pin(0));
+			circuit.connect(R->pin(1), nodes[b]->pin(0));
+		};
+
+		// the chain keeps the graph connected
+		for (size_t i = 1; i < n; ++i) add_edge(i - 1, i);
+
+		const size_t num_edges = n * degree / 2;
+		while (id < num_edges) {
+			const size_t a = pick(rng);
+			const size_t b = pick(rng);
+			if (a != b) add_edge(a, b);
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../circuits/src/circuit/circuit.h"
+#include <cstdint>
+
+
+/* Synthetic circuits for the benchmarks, built only through Circuit::add_part and Circuit::connect.
+ * Every circuit is driven by a voltage source through a resistor, compiling is left to the caller. */
+namespace generators {
+	// n sections of a series resistor and a capacitor to ground
+	void rc_ladder(Circuit &circuit, size_t n);
+
+	// w x h grid of nodes with a capacitor to ground at every node,
+	// resistors between horizontal neighbours and inductors between vertical ones
+	void rlc_mesh(Circuit &circuit, size_t w, size_t h);
+
+	// RC ladder with a switched load to ground on every section, the switches are split into groups,
+	// group g toggles every period << g steps, so the groups count through all 2^groups states,
+	// the toggles are scheduled for the first num_steps steps
+	void switch_network(Circuit &circuit, size_t n, size_t groups, size_t period, size_t num_steps);
+
+	// n nodes with a capacitor to ground each, connected by a chain of resistors
+	// and extra resistors between random pairs until the mean degree is reached
+	void random_graph(Circuit &circuit, size_t n, size_t degree, uint32_t seed);
+}
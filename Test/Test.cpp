@@ -3,7 +3,25 @@
 
 #include "string_repr.h"
 
+#include "../circuits/src/circuit/circuit.h"
+#include "../circuits/src/circuit/parts/capacitor.h"
+#include "../circuits/src/circuit/parts/resistor.h"
+#include "../circuits/src/circuit/parts/switch.h"
+#include "../circuits/src/circuit/parts/voltage_source.h"
+#include "../circuits/src/circuit/table_file.h"
+#include "../circuits/src/circuit/task_scheduler.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -132,5 +150,613 @@ namespace Test {
 				Assert::AreEqual(b, test_b);
 			}
 		}
+
+		TEST_METHOD(TestDenseLU) {
+			std::mt19937 rng(0);
+
+			constexpr size_t num_tests = 100;
+			constexpr size_t num_solves = 5;
+
+			for (size_t i = 0; i < num_tests; ++i) {
+				size_t n = 2 + i / 2;
+				const Matrix<Z_7> M = Matrix<Z_7>::make_random(rng, n, n);
+
+				DenseLU<Z_7> lu;
+
+				try {
+					lu.factorize(M);
+				}
+				catch (const singular_matrix_exception &e) {
+					continue;
+				}
+
+				// one factorization, many right hand sides
+				for (size_t j = 0; j < num_solves; ++j) {
+					const Vector<Z_7> b = Vector<Z_7>::make_random(rng, n);
+					Vector<Z_7> x = b;
+					lu.solve(x);
+
+					Assert::AreEqual(b, M * x);
+				}
+			}
+		}
+
+		TEST_METHOD(TestSparseFromTriplets) {
+			const SparseMatrix<Z_7> S = SparseMatrix<Z_7>::from_triplets(2, 3, {
+				{1, 2, 3},
+				{0, 0, 1},
+				{1, 2, 6},
+				{0, 1, 2}
+			});
+
+			const Matrix<Z_7> expected = {
+				{1, 2, 0},
+				{0, 0, 2}
+			};
+
+			Assert::AreEqual(size_t(3), S.nnz());
+			Assert::AreEqual(expected, S.to_dense());
+		}
+
+		TEST_METHOD(TestSparseFromPattern) {
+			const std::vector<std::pair<size_t, size_t>> positions = {
+				{1, 1},
+				{0, 1},
+				{1, 1},
+				{0, 0}
+			};
+
+			std::vector<size_t> value_ids;
+			SparseMatrix<Z_7> S = SparseMatrix<Z_7>::from_pattern(2, 2, positions, value_ids);
+
+			Assert::AreEqual(size_t(3), S.nnz());
+			Assert::AreEqual(value_ids[0], value_ids[2]);
+
+			// write through the value ids
+			const Z_7 values[] = {1, 2, 3, 4};
+			for (size_t i = 0; i < positions.size(); ++i) {
+				S.values()[value_ids[i]] += values[i];
+			}
+
+			const Matrix<Z_7> expected = {
+				{4, 2},
+				{0, 4}
+			};
+
+			Assert::AreEqual(expected, S.to_dense());
+		}
+
+		TEST_METHOD(TestSparseLU) {
+			std::mt19937 rng(0);
+			std::uniform_int_distribution<int> keep(0, 3);
+
+			constexpr size_t num_tests = 300;
+
+			for (size_t i = 0; i < num_tests; ++i) {
+				size_t n = 2 + i / 3;
+				Matrix<Z_7> M = Matrix<Z_7>::make_random(rng, n, n);
+				const Vector<Z_7> b = Vector<Z_7>::make_random(rng, n);
+
+				// keep roughly a quarter of the off-diagonal entries
+				for (size_t r = 0; r < n; ++r) {
+					for (size_t c = 0; c < n; ++c) {
+						if (r != c && keep(rng) != 0) M(r, c) = 0;
+					}
+				}
+
+				Vector<Z_7> x = b;
+
+				try {
+					SparseLU<Z_7> lu{ SparseMatrix<Z_7>(M) };
+					lu.solve(x);
+				}
+				catch (const singular_matrix_exception &e) {
+					continue;
+				}
+
+				const Vector<Z_7> test_b = M * x;
+
+				Assert::AreEqual(b, test_b);
+			}
+		}
+
+		TEST_METHOD(TestSparseLUColumnOrder) {
+			std::mt19937 rng(0);
+			std::uniform_int_distribution<int> keep(0, 3);
+
+			constexpr size_t num_tests = 300;
+
+			for (size_t i = 0; i < num_tests; ++i) {
+				size_t n = 2 + i / 3;
+				Matrix<Z_7> M = Matrix<Z_7>::make_random(rng, n, n);
+				const Vector<Z_7> b = Vector<Z_7>::make_random(rng, n);
+
+				for (size_t r = 0; r < n; ++r) {
+					for (size_t c = 0; c < n; ++c) {
+						if (r != c && keep(rng) != 0) M(r, c) = 0;
+					}
+				}
+
+				const SparseMatrix<Z_7> S(M);
+				Vector<Z_7> x = b;
+
+				try {
+					SparseLU<Z_7> lu;
+					lu.set_column_order(minimum_degree_order(S).order);
+					lu.factorize(S);
+					lu.solve(x);
+				}
+				catch (const singular_matrix_exception &e) {
+					continue;
+				}
+
+				Assert::AreEqual(b, M * x);
+			}
+		}
+
+		TEST_METHOD(TestDiagonalUpdate) {
+			std::mt19937 rng(0);
+			std::uniform_int_distribution<int> keep(0, 3);
+
+			constexpr size_t num_tests = 300;
+
+			for (size_t i = 0; i < num_tests; ++i) {
+				size_t n = 2 + i / 3;
+				Matrix<Z_7> M = Matrix<Z_7>::make_random(rng, n, n);
+				const Vector<Z_7> b = Vector<Z_7>::make_random(rng, n);
+
+				for (size_t r = 0; r < n; ++r) {
+					for (size_t c = 0; c < n; ++c) {
+						if (r != c && keep(rng) != 0) M(r, c) = 0;
+					}
+				}
+
+				// change up to three diagonal entries
+				std::vector<std::pair<size_t, Z_7>> updates;
+				Matrix<Z_7> updated = M;
+				for (size_t r = 0; r < n && updates.size() < 3; r += 1 + i % 2) {
+					const Z_7 delta = Z_7::make_random(rng);
+					updates.push_back({ r, delta });
+					updated(r, r) += delta;
+				}
+
+				Vector<Z_7> x = b;
+
+				try {
+					SparseLU<Z_7> lu{ SparseMatrix<Z_7>(M) };
+					DiagonalUpdate<Z_7> update;
+					update.reset(lu);
+					update.set(updates);
+					update.solve(std::span<Z_7>(&x[0], n));
+				}
+				catch (const singular_matrix_exception &e) {
+					continue;
+				}
+
+				Assert::AreEqual(b, updated * x);
+			}
+		}
+
+		TEST_METHOD(TestSparseLULanes) {
+			std::mt19937 rng(0);
+			std::uniform_real_distribution<double> dist(-1.0, 1.0);
+			std::uniform_int_distribution<int> keep(0, 3);
+
+			constexpr size_t num_lanes = 4;
+			using L = Lanes<double, num_lanes>;
+
+			for (size_t n : { 1, 2, 5, 12, 30 }) {
+				// the same structure in every lane, different values
+				std::vector<Matrix<double>> M(num_lanes, Matrix<double>(n, n));
+				std::vector<Vector<double>> b(num_lanes, Vector<double>(n));
+
+				for (size_t r = 0; r < n; ++r) {
+					for (size_t c = 0; c < n; ++c) {
+						if (r != c && keep(rng) != 0) continue;
+						for (size_t l = 0; l < num_lanes; ++l) {
+							M[l](r, c) = dist(rng) + (r == c ? 2.0 * n : 0.0);
+						}
+					}
+					for (size_t l = 0; l < num_lanes; ++l) b[l][r] = dist(rng);
+				}
+
+				const SparseMatrix<double> S(M[0]);
+				SparseMatrix<L> lanes_matrix = SparseMatrix<L>::with_structure_of(S);
+				std::vector<L> x(n);
+
+				const auto &col_starts = lanes_matrix.col_starts_array();
+				const auto &row_ids = lanes_matrix.row_ids_array();
+				for (size_t j = 0; j < n; ++j) {
+					for (size_t p = col_starts[j]; p < col_starts[j + 1]; ++p) {
+						for (size_t l = 0; l < num_lanes; ++l) lanes_matrix.values()[p][l] = M[l](row_ids[p], j);
+					}
+				}
+				for (size_t i = 0; i < n; ++i) {
+					for (size_t l = 0; l < num_lanes; ++l) x[i][l] = b[l][i];
+				}
+
+				SparseLU<L> lu;
+				lu.set_column_order(minimum_degree_order(S).order);
+				lu.factorize(lanes_matrix);
+				lu.solve(std::span<L>(x));
+
+				for (size_t l = 0; l < num_lanes; ++l) {
+					Vector<double> x_lane(n);
+					for (size_t i = 0; i < n; ++i) x_lane[i] = x[i][l];
+
+					const Vector<double> test_b = M[l] * x_lane;
+					for (size_t i = 0; i < n; ++i) {
+						Assert::AreEqual(b[l][i], test_b[i], 1e-12);
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(TestMinimumDegreeOrder) {
+			// arrow matrix, eliminating the dense row and column first fills everything
+			constexpr size_t n = 20;
+			Matrix<double> M(n, n);
+
+			for (size_t i = 0; i < n; ++i) {
+				M(i, i) = 4.0 * n;
+				if (i == 0) continue;
+				M(0, i) = 1.0;
+				M(i, 0) = 1.0;
+			}
+
+			const SparseMatrix<double> S(M);
+
+			std::vector<size_t> natural(n);
+			for (size_t i = 0; i < n; ++i) natural[i] = i;
+			Assert::AreEqual(n * (n + 1), predict_lu_nnz(S, natural));
+
+			const FillReducingOrder ordering = minimum_degree_order(S);
+			Assert::IsTrue(ordering.order.front() != 0);
+			Assert::AreEqual(4 * n - 2, ordering.predicted_nnz);
+
+			SparseLU<double> lu;
+			lu.set_column_order(ordering.order);
+			lu.factorize(S);
+			Assert::AreEqual(ordering.predicted_nnz, lu.nnz());
+		}
+
+		TEST_METHOD(TestDenseKernels) {
+			std::mt19937 rng(0);
+			std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+			// sizes around the vector widths to hit the remainder loops
+			for (size_t n : { 1, 3, 7, 8, 9, 17, 33 }) {
+				Matrix<double> A(n, n);
+				Matrix<double> B(n, n);
+				Vector<double> v(n);
+
+				for (size_t i = 0; i < n; ++i) {
+					for (size_t j = 0; j < n; ++j) {
+						A(i, j) = dist(rng);
+						B(i, j) = dist(rng);
+					}
+					A(i, i) += n; // keep it well conditioned
+					v[i] = dist(rng);
+				}
+
+				const Matrix<double> C = A * B;
+				const Vector<double> Av = A * v;
+
+				for (size_t i = 0; i < n; ++i) {
+					double expected_Av = 0.0;
+					for (size_t k = 0; k < n; ++k) {
+						expected_Av += A(i, k) * v[k];
+					}
+					Assert::AreEqual(expected_Av, Av[i], 1e-12);
+
+					for (size_t j = 0; j < n; ++j) {
+						double expected_C = 0.0;
+						for (size_t k = 0; k < n; ++k) {
+							expected_C += A(i, k) * B(k, j);
+						}
+						Assert::AreEqual(expected_C, C(i, j), 1e-12);
+					}
+				}
+
+				DenseLU<double> lu(A);
+				Vector<double> x = v;
+				lu.solve(x);
+
+				const Vector<double> test_v = A * x;
+
+				for (size_t i = 0; i < n; ++i) {
+					Assert::AreEqual(v[i], test_v[i], 1e-12);
+				}
+			}
+		}
+	};
+
+	TEST_CLASS(TestTaskScheduler) {
+		// Runs the graph num_runs times, checks every task ran once per run and after all its predecessors.
+		static void check_runs(size_t num_threads, const std::vector<std::vector<size_t>> &successors, size_t num_runs) {
+			const size_t n = successors.size();
+			std::vector<std::vector<size_t>> predecessors(n);
+			for (size_t i = 0; i < n; ++i) {
+				for (size_t s : successors[i]) predecessors[s].push_back(i);
+			}
+
+			std::vector<std::atomic<size_t>> runs(n);
+			std::atomic<size_t> early_tasks{ 0 };
+			// written between the runs only
+			size_t run = 0;
+
+			TaskScheduler scheduler(num_threads, successors, [&](size_t task) {
+				for (size_t p : predecessors[task]) {
+					if (runs[p].load(std::memory_order_acquire) != run + 1) early_tasks.fetch_add(1);
+				}
+				runs[task].fetch_add(1, std::memory_order_release);
+			});
+
+			for (; run < num_runs; ++run) {
+				scheduler.run();
+				for (size_t i = 0; i < n; ++i) {
+					Assert::AreEqual(run + 1, runs[i].load());
+				}
+			}
+			Assert::AreEqual(size_t(0), early_tasks.load());
+		}
+
+		TEST_METHOD(TestTopologicalOrder) {
+			const std::vector<std::vector<size_t>> diamond = { { 1, 2 }, { 3 }, { 3 }, {} };
+			const auto order = TaskScheduler::topological_order(diamond);
+			Assert::IsTrue(order.has_value());
+			Assert::AreEqual(size_t(4), order->size());
+			Assert::AreEqual(size_t(0), order->front());
+			Assert::AreEqual(size_t(3), order->back());
+
+			const std::vector<std::vector<size_t>> cycle = { { 1 }, { 2 }, { 0 } };
+			Assert::IsFalse(TaskScheduler::topological_order(cycle).has_value());
+			Assert::ExpectException<std::runtime_error>([&] { TaskScheduler(2, cycle, [](size_t) {}); });
+		}
+
+		TEST_METHOD(TestDependencies) {
+			// a chain, a diamond and a random graph, the edges go from the lower index to the higher
+			std::vector<std::vector<size_t>> chain(16);
+			for (size_t i = 0; i + 1 < chain.size(); ++i) chain[i] = { i + 1 };
+			check_runs(4, chain, 200);
+
+			check_runs(3, { { 1, 2, 3 }, { 4 }, { 4 }, { 4 }, {} }, 200);
+
+			std::mt19937 rng(0);
+			std::uniform_int_distribution<int> edge(0, 9);
+			std::vector<std::vector<size_t>> graph(40);
+			for (size_t i = 0; i < graph.size(); ++i) {
+				for (size_t j = i + 1; j < graph.size(); ++j) {
+					if (edge(rng) == 0) graph[i].push_back(j);
+				}
+			}
+			for (size_t num_threads : { 1, 2, 4 }) {
+				check_runs(num_threads, graph, 200);
+			}
+		}
+
+		TEST_METHOD(TestManySmallTasks) {
+			// far more tasks than workers, the workers keep stealing the last tasks of each other
+			std::vector<std::vector<size_t>> independent(256);
+			check_runs(8, independent, 1000);
+
+			// wide layers, every task of a layer waits for the whole previous one
+			const size_t width = 32;
+			std::vector<std::vector<size_t>> layers(4 * width);
+			for (size_t i = 0; i + width < layers.size(); ++i) {
+				const size_t next_layer = (i / width + 1) * width;
+				for (size_t j = next_layer; j < next_layer + width; ++j) layers[i].push_back(j);
+			}
+			check_runs(8, layers, 1000);
+		}
+
+		TEST_METHOD(TestDequeLastTask) {
+			// the owner keeps the deque at one task while a thief steals, every task is taken once
+			constexpr size_t num_tasks = 100000;
+			TaskDeque deque(num_tasks);
+			std::vector<std::atomic<int>> taken(num_tasks);
+			std::atomic<bool> done{ false };
+
+			std::thread thief([&] {
+				size_t task;
+				while (!done.load()) {
+					if (deque.steal(task)) taken[task].fetch_add(1);
+				}
+			});
+
+			size_t task;
+			for (size_t i = 0; i < num_tasks; ++i) {
+				deque.push(i);
+				if (i % 2 == 1 && deque.pop(task)) taken[task].fetch_add(1);
+			}
+			while (deque.pop(task)) taken[task].fetch_add(1);
+
+			done.store(true);
+			thief.join();
+
+			for (size_t i = 0; i < num_tasks; ++i) {
+				Assert::AreEqual(1, taken[i].load());
+			}
+		}
+	};
+
+	TEST_CLASS(TestTableFile) {
+		static fs::path temp_path(const char *name) {
+			return fs::temp_directory_path() / name;
+		}
+
+		static std::vector<char> read_bytes(const fs::path &path) {
+			std::ifstream file(path, std::ios::binary);
+			return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		static void write_bytes(const fs::path &path, const std::vector<char> &bytes) {
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(bytes.data(), bytes.size());
+		}
+
+		template <typename T>
+		static void check_round_trip(const char *name) {
+			const fs::path path = temp_path(name);
+			const fs::path csv_path = fs::path(path).replace_extension(".csv");
+
+			std::vector<T> voltage, current;
+			for (size_t i = 0; i < 1000; ++i) {
+				voltage.push_back(static_cast<T>(std::sin(0.01 * i)));
+				current.push_back(static_cast<T>(1e-3 * i));
+			}
+			const std::vector<BasicTableColumn<T>> columns = {
+				{ .name = "voltage-between-a-and-b", .unit = "V", .values = voltage },
+				{ .name = "current-between-c-and-d", .unit = "A", .values = current },
+			};
+			write_table<T>(path, 0.5, 1e-3, columns);
+
+			{
+				TableReader reader(path);
+				Assert::AreEqual(size_t(2), reader.get_num_columns());
+				Assert::AreEqual(voltage.size(), reader.get_num_samples());
+				Assert::AreEqual(sizeof(T), reader.get_value_size());
+				Assert::AreEqual(0.5, reader.get_start_time());
+				Assert::AreEqual(1e-3, reader.get_sample_period());
+				Assert::AreEqual(std::string("voltage-between-a-and-b"), reader.get_name(0));
+				Assert::AreEqual(std::string("A"), reader.get_unit(1));
+
+				const std::span<const T> stored = reader.template get_column<T>(0);
+				for (size_t i = 0; i < voltage.size(); ++i) {
+					Assert::AreEqual(voltage[i], stored[i]);
+					Assert::AreEqual(static_cast<double>(current[i]), reader.get_value(1, i));
+				}
+
+				using Other = std::conditional_t<std::is_same_v<T, float>, double, float>;
+				Assert::ExpectException<TableError>([&] { reader.template get_column<Other>(0); });
+				Assert::ExpectException<TableError>([&] { reader.get_value(2, 0); });
+
+				reader.write_csv(csv_path);
+			}
+
+			std::ifstream csv(csv_path);
+			std::string line;
+			std::getline(csv, line);
+			Assert::AreEqual(std::string("time,voltage-between-a-and-b,current-between-c-and-d"), line);
+
+			size_t rows = 0;
+			while (std::getline(csv, line)) {
+				double time, v, c;
+				Assert::AreEqual(3, std::sscanf(line.c_str(), "%lf,%lf,%lf", &time, &v, &c));
+				Assert::AreEqual(0.5 + rows * 1e-3, time, 1e-9);
+				Assert::AreEqual(static_cast<double>(voltage[rows]), v, 1e-5);
+				Assert::AreEqual(static_cast<double>(current[rows]), c, 1e-5 * (1.0 + std::abs(c)));
+				++rows;
+			}
+			Assert::AreEqual(voltage.size(), rows);
+
+			fs::remove(path);
+			fs::remove(csv_path);
+		}
+
+		TEST_METHOD(TestRoundTripFloat) {
+			check_round_trip<float>("simlogue_test_float.slt");
+		}
+
+		TEST_METHOD(TestRoundTripDouble) {
+			check_round_trip<double>("simlogue_test_double.slt");
+		}
+
+		TEST_METHOD(TestDifferentLengths) {
+			const std::vector<double> a(10), b(11);
+			const std::vector<BasicTableColumn<double>> columns = { { .name = "a", .unit = "V", .values = a }, { .name = "b", .unit = "V", .values = b } };
+			Assert::ExpectException<TableError>([&] { write_table<double>(temp_path("simlogue_test_lengths.slt"), 0.0, 1.0, columns); });
+		}
+
+		TEST_METHOD(TestDamagedFiles) {
+			const fs::path valid_path = temp_path("simlogue_test_valid.slt");
+			const fs::path path = temp_path("simlogue_test_damaged.slt");
+
+			const std::vector<double> values(100, 1.0);
+			const std::vector<BasicTableColumn<double>> columns = { { .name = "a", .unit = "V", .values = values }, { .name = "b", .unit = "A", .values = values } };
+			write_table<double>(valid_path, 0.0, 1.0, columns);
+			const std::vector<char> valid = read_bytes(valid_path);
+
+			auto expect_error = [&](const std::vector<char> &bytes) {
+				write_bytes(path, bytes);
+				Assert::ExpectException<TableError>([&] { TableReader reader(path); });
+			};
+			// the header fields are at fixed offsets, see binary_table in table_file.h
+			auto patched = [&]<typename F>(size_t offset, F value) {
+				std::vector<char> bytes = valid;
+				std::memcpy(bytes.data() + offset, &value, sizeof(value));
+				return bytes;
+			};
+
+			// truncated in the header, in the names and in the data
+			for (size_t length : { size_t(0), size_t(5), size_t(30), size_t(60), valid.size() - 1 }) {
+				expect_error(std::vector<char>(valid.begin(), valid.begin() + length));
+			}
+
+			std::vector<char> not_a_table = valid;
+			not_a_table[0] = 'X';
+			expect_error(not_a_table);
+
+			expect_error(patched(8, uint32_t(2)));                  // version
+			expect_error(patched(12, uint32_t(3)));                 // value size
+			expect_error(patched(16, uint64_t(1) << 40));           // column count
+			expect_error(patched(24, uint64_t(101)));               // sample count
+			expect_error(patched(24, ~uint64_t(0)));
+			expect_error(patched(48, uint64_t(0)));                 // data offset inside the header
+			expect_error(patched(48, uint64_t(96)));                // not aligned
+			expect_error(patched(48, uint64_t(valid.size() + 64))); // past the end
+			expect_error(patched(56, ~uint32_t(0)));                // name length
+
+			// the untouched copy still reads
+			TableReader reader(valid_path);
+			Assert::AreEqual(size_t(100), reader.get_num_samples());
+
+			fs::remove(valid_path);
+			fs::remove(path);
+		}
+	};
+
+	TEST_CLASS(TestSwitchEvents) {
+		// The current of the capacitor in V1 - S1 - R1 - C1 - GND, the switch turns on at 1ms and off at 3ms.
+		static std::vector<scalar> render_rc(size_t cache_budget) {
+			Circuit circuit(10_u);
+			circuit.set_oversampling(1);
+			circuit.set_factorization_cache_budget(cache_budget);
+
+			VoltageSource *V1 = circuit.add_part<VoltageSource>("V1", 5.0);
+			Switch *S1 = circuit.add_part<Switch>("S1");
+			Resistor *R1 = circuit.add_part<Resistor>("R1", 1_k);
+			Capacitor *C1 = circuit.add_part<Capacitor>("C1", 1_u);
+
+			circuit.connect(V1->pin(), S1->pin(0));
+			circuit.connect(S1->pin(1), R1->pin(0));
+			circuit.connect(R1->pin(1), C1->pin(0));
+			circuit.connect(C1->pin(1), circuit.get_ground()->pin());
+			circuit.scope_current(C1);
+
+			S1->schedule_on(1_m);
+			S1->schedule_off(3_m);
+			circuit.compile();
+
+			std::vector<scalar> current(600);
+			for (scalar &frame : current) {
+				circuit.render_frame(std::span<scalar>(&frame, 1));
+			}
+			return current;
+		}
+
+		TEST_METHOD(TestToggleBackWithoutCache) {
+			// without the cache the switch turns on by a low rank update, turning it off
+			// must drop the update instead of keeping the switch on
+			const auto uncached = render_rc(0);
+			const auto cached = render_rc(FactorizationCache::default_budget_bytes);
+
+			for (size_t i = 0; i < cached.size(); ++i) {
+				Assert::AreEqual(double(cached[i]), double(uncached[i]), 1e-6);
+			}
+
+			// the capacitor discharges through the off resistance only
+			Assert::IsTrue(std::abs(uncached.back()) < 1e-6);
+		}
 	};
 }
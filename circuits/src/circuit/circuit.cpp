@@ -1,18 +1,29 @@
 #include "../lingebra/lingebra.h"
 #include "circuit.h"
+#include "decimator.h"
+#include "engine.h"
 #include "interpreter.h"
 #include "node.h"
 #include "part.h"
 #include "parts/voltage_source.h"
 #include "pin.h"
+#include "profiler.h"
 #include "scalar.h"
 #include "scope.h"
+#include "scope_writer.h"
+#include "stamp_pattern.h"
 #include "util.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <filesystem>
+#include <format>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <optional>
 #include <sstream>
 #include <utility>
 
@@ -24,6 +35,7 @@ Circuit::Circuit(scalar timestep, const fs::path &scope_export_path) :
 	interpreter(std::make_unique<Interpreter>(*this)) {
 	fs::create_directories(this->scope_export_path);
 	fs::create_directories(scope_export_path / "latest");
+	timebase.period = timestep * oversampling;
 	ground = add_part<VoltageSource>("GND", 0.0f);
 	Node *ground_node = create_new_node();
 	ground_node->is_ground = true;
@@ -46,6 +58,8 @@ Node *Circuit::create_new_node() {
 }
 
 void Circuit::connect(const Pin &pin_a, const Pin &pin_b) {
+	compiled = false;
+
 	if (pin_a.node == pin_b.node) {
 		if (pin_a.node == nullptr) {
 			Node *node = create_new_node();
@@ -56,14 +70,40 @@ void Circuit::connect(const Pin &pin_a, const Pin &pin_b) {
 	else if (pin_a.node == nullptr) {
 		pin_a.owner->set_node(pin_a.pin_id, pin_b.node);
 	}
-	else {
+	else if (pin_b.node == nullptr) {
 		pin_b.owner->set_node(pin_b.pin_id, pin_a.node);
 	}
+	else {
+		// merge the two nodes, the ground node survives
+		Node *kept = pin_b.node->is_ground ? pin_b.node : pin_a.node;
+		Node *merged = (kept == pin_a.node) ? pin_b.node : pin_a.node;
+
+		for (auto &part : parts) {
+			for (size_t i = 0; i < part->pin_count(); ++i) {
+				if (part->pin(i).node == merged) part->set_node(i, kept);
+			}
+		}
+
+		std::erase_if(nodes, [merged](const auto &node) { return node.get() == merged; });
+	}
 }
 
-lingebra::Matrix<scalar> Circuit::build_matrix(const StampParams &params) const {
-	// reserve rows
-	size_t num_rows = 0;
+void Circuit::validate() const {
+	for (const auto &part : parts) {
+		for (size_t i = 0; i < part->pin_count(); ++i) {
+			ConstPin pin = std::as_const(*part).pin(i);
+			if (pin.node == nullptr) {
+				throw CompileError(std::format("Pin {} is not connected", pin.name));
+			}
+		}
+	}
+}
+
+void Circuit::compile() {
+	validate();
+
+	// assign rows, nodes first, then the branches, the ground row is the last one
+	num_rows = 0;
 
 	for (auto &node : nodes) {
 		if (node->is_ground) continue;
@@ -75,106 +115,864 @@ lingebra::Matrix<scalar> Circuit::build_matrix(const StampParams &params) const
 		num_rows += part->num_needed_matrix_rows();
 	}
 
-	// [(row, column, data), ...]
-	std::vector<std::tuple<size_t, size_t, scalar>> matrix_entries;
+	const size_t ground_row = num_rows;
+	ground->pin().node->node_id = ground_row;
 
-	for (const auto &part : parts) {
-		matrix_entries.append_range(part->gen_matrix_entries(params));
+	engine.reset(num_rows);
+
+	for (auto &part : parts) {
+		part->compile(engine);
+	}
+	for (auto &scope : scopes) {
+		scope->bind(engine.get_solution());
+	}
+	for (auto &output : process_outputs) {
+		output.probe->bind(engine.get_solution());
 	}
 
-	lingebra::Matrix<scalar> matrix(num_rows, num_rows);
+	// the inputs drive their batch entries, found by the branch row
+	const auto &source_branches = engine.voltage_sources.branch;
+	for (auto &input : process_inputs) {
+		const auto it = input.source->num_needed_matrix_rows() == 0 ? source_branches.end()
+			: std::find(source_branches.begin(), source_branches.end(), input.source->get_first_matrix_row_id());
+
+		if (it == source_branches.end()) {
+			throw CompileError(std::format("The input {} is a voltage source connected to the ground", input.source->get_name()));
+		}
 
-	for (const auto &[row, col, value] : matrix_entries) {
-		matrix(row, col) += value;
+		input.batch_id = static_cast<size_t>(it - source_branches.begin());
+		input.offset = engine.voltage_sources.voltage[input.batch_id];
 	}
 
-	return matrix;
+	// reserve the matrix entries
+	StampPattern pattern(ground_row);
+	engine.reserve_matrix_entries(pattern);
+
+	matrix = lingebra::SparseMatrix<scalar>::from_pattern(num_rows, num_rows, pattern.get_positions(), slot_value_ids);
+
+	// the node numbering is the creation order, reorder the columns to keep the fill low
+	lingebra::FillReducingOrder ordering = lingebra::minimum_degree_order(matrix);
+	predicted_lu_nnz = ordering.predicted_nnz;
+	lu.set_column_order(std::move(ordering.order));
+
+	std::vector<size_t> natural_order(num_rows);
+	std::iota(natural_order.begin(), natural_order.end(), 0);
+	natural_lu_nnz = lingebra::predict_lu_nnz(matrix, natural_order);
+	fill_reported = false;
+
+	factorizations.clear();
+	cache_factorizations = factorizations.is_enabled();
+
+	parameter_ramps.clear();
+	parameter_ramps.reserve(parts.size());
+
+	stats = SolverStats{};
+
+	compiled = true;
+	needs_factorization = true;
+	restart_integration = true;
+	needs_operating_point = true;
+	render_step = 0;
+	processing_prepared = false;
+	process_error = false;
 }
 
-void Circuit::update(size_t step) {
-	StampParams params{
-		.ground = ground->pin(),
-		.timestep = timestep,
-		.timestep_inv = 1.0 / timestep,
-		.step = step
-	};
+void Circuit::stamp_matrix(const StampParams &params) {
+	Profiler::Timer timer(profiler, Phase::assemble);
+	engine.stamp_matrix(params);
+	const auto &stamp_values = engine.get_stamp_values();
 
-	// TODO: update the matrix instead of building it anew
-	auto matrix = build_matrix(params);
+	auto &values = matrix.values();
+	std::fill(values.begin(), values.end(), 0.0);
 
-	std::vector<scalar> rhs(matrix.m(), 0.0);
+	// slot i + 1 goes to values[slot_value_ids[i]], slot 0 is discarded
+	for (size_t i = 0; i < slot_value_ids.size(); ++i) {
+		values[slot_value_ids[i]] += stamp_values[i + 1];
+	}
+}
 
-	for (auto &part : parts) {
-		part->stamp_rhs_entries(rhs, params);
+void Circuit::report_fill() const {
+	std::cout << std::format(
+		"Matrix {0}x{0} with {1} entries, LU entries: {2} predicted, {3} actual ({4} predicted without reordering)\n",
+		num_rows, matrix.nnz(), predicted_lu_nnz, lu.nnz(), natural_lu_nnz
+	);
+}
+
+void Circuit::report_factorization_cache() const {
+	std::cout << std::format(
+		"Factorization cache: {} hits, {} misses, {} evictions, {} entries in {:.1f} of {:.1f} KiB\n",
+		factorizations.get_hits(), factorizations.get_misses(), factorizations.get_evictions(),
+		factorizations.size(), factorizations.get_used_bytes() / 1024.0, factorizations.get_budget() / 1024.0
+	);
+}
+
+SolverStats Circuit::get_solver_stats() const {
+	SolverStats result = stats;
+	result.num_rows = num_rows;
+	result.matrix_nnz = matrix.nnz();
+	result.predicted_lu_nnz = predicted_lu_nnz;
+	result.lu_nnz = lu.nnz();
+	result.lu_bytes = lu.memory_bytes();
+	return result;
+}
+
+void Circuit::set_factorization_cache_budget(size_t bytes) {
+	// the solver may use a cached factorization the new budget evicts
+	needs_factorization = true;
+	factorizations.set_budget(bytes);
+	cache_factorizations = factorizations.is_enabled();
+}
+
+void Circuit::set_adaptive_timestep(scalar min_timestep, scalar max_timestep, scalar tolerance) {
+	if (!(min_timestep > 0.0) || max_timestep < min_timestep || !(tolerance > 0.0)) {
+		throw std::runtime_error("The adaptive timestep needs 0 < min_timestep <= max_timestep and a positive tolerance");
 	}
 
-	lingebra::Vector<scalar> rhs_vec(rhs);
+	adaptive_min_timestep = min_timestep;
+	adaptive_max_timestep = max_timestep;
+	adaptive_tolerance = tolerance;
+	// the solver may use a cached factorization
+	needs_factorization = true;
+	factorizations.clear();
+}
 
-	//std::cout << matrix.repr() << "\n" << rhs_vec.repr() << "\n";
+void Circuit::disable_adaptive_timestep() {
+	adaptive_max_timestep = 0.0;
+	needs_factorization = true;
+	factorizations.clear();
+}
+
+bool Circuit::solve_operating_point() {
+	if (!compiled) {
+		throw std::runtime_error("The circuit must be compiled before solving the operating point, call Circuit::compile()");
+	}
 
-	lingebra::solve_gaussian_elimination(matrix, rhs_vec);
+	needs_operating_point = false;
 
-	for (auto &part : parts) {
-		for (size_t i = 0; i < part->num_needed_matrix_rows(); ++i) {
-			part->update_value_from_result(i, rhs_vec[part->get_first_matrix_row_id() + i]);
+	const StampParams params = Engine::operating_point_params();
+
+	// the transient matrix is factorized again by the next step, the DC one is not cached
+	needs_factorization = true;
+	restart_integration = true;
+
+	stamp_matrix(params);
+	try {
+		Profiler::Timer timer(profiler, Phase::factorize);
+		lu.factorize(matrix);
+		++stats.factorizations;
+	}
+	catch (const lingebra::singular_matrix_exception &) {
+		if (verbose) std::cout << "Singular DC matrix, starting from rest\n";
+		return false;
+	}
+
+	engine.stamp_rhs(params);
+	lu.solve(engine.get_system_rhs());
+	engine.set_operating_point(params);
+
+	if (verbose) std::cout << "Solved the DC operating point\n";
+	return true;
+}
+
+StampParams Circuit::make_stamp_params(scalar dt, size_t step) const {
+	return StampParams{
+		.timestep = dt,
+		.timestep_inv = 1.0 / dt,
+		.step = step,
+		.integration = integration_coefficients(integration_method)
+	};
+}
+
+void Circuit::get_factorization_key(FactorizationCache::Key &key, int level) const {
+	engine.get_switch_state(key);
+	if (!is_adaptive()) return;
+
+	// the levels are within +-64
+	for (int bit = 0; bit < 8; ++bit) {
+		key.push_back(((level + 64) >> bit) & 1);
+	}
+}
+
+void Circuit::prepare_solver(const StampParams &params, int level) {
+	if (engine.stamp_changed()) restart_integration = true;
+
+	const bool level_changed = level != stamped_level;
+
+	if ((engine.stamp_changed() || level_changed) && !needs_factorization && cache_factorizations) {
+		Profiler::Timer timer(profiler, Phase::cache_lookup);
+		get_factorization_key(switch_state, level);
+
+		if (const auto *cached = factorizations.find(switch_state)) {
+			lu_update.reset(*cached);
+			engine.mark_stamped();
+			stamped_level = level;
+			++stats.cache_hits;
+		}
+		else {
+			needs_factorization = true;
 		}
 	}
-	for (auto &node : nodes) {
-		if (node->is_ground) continue;
-		node->voltage = rhs_vec[node->node_id];
+	else if (level_changed) {
+		needs_factorization = true;
 	}
+	else if (engine.stamp_changed() && !needs_factorization) {
+		Profiler::Timer timer(profiler, Phase::low_rank_update);
+		engine.collect_stamp_changes(stamp_changes);
 
-	for (auto &part : parts) {
-		part->update(params);
+		if (stamp_changes.size() > max_update_rank) {
+			needs_factorization = true;
+		}
+		else {
+			try {
+				lu_update.set(stamp_changes);
+				++stats.low_rank_updates;
+			}
+			catch (const lingebra::singular_matrix_exception &) {
+				// let the full factorization decide
+				needs_factorization = true;
+			}
+		}
+	}
+
+	if (needs_factorization) {
+		stamp_matrix(params);
+		{
+			Profiler::Timer timer(profiler, Phase::factorize);
+			lu.factorize(matrix);
+			lu_update.reset(lu);
+			needs_factorization = false;
+			stamped_level = level;
+			++stats.factorizations;
+
+			if (cache_factorizations) {
+				get_factorization_key(switch_state, level);
+				// too large to cache, fall back to the low rank updates
+				if (!factorizations.insert(switch_state, lu)) cache_factorizations = false;
+			}
+		}
+
+		if (!fill_reported) {
+			if (verbose) report_fill();
+			fill_reported = true;
+		}
+	}
+}
+
+void Circuit::solve_step(const StampParams &params) {
+	// the restart rebuilds the history for the timestep anyway
+	if (params.timestep != history_timestep && !restart_integration) {
+		engine.rescale_history(history_timestep, params.timestep);
+	}
+	history_timestep = params.timestep;
+
+	// backward euler needs no history
+	if (restart_integration && integration_method != IntegrationMethod::backward_euler) {
+		Profiler::Timer timer(profiler, Phase::solve);
+		const StampParams probe_params = restart_probe_params(params);
+		engine.stamp_rhs(probe_params);
+		lu_update.solve(engine.get_system_rhs());
+		engine.restart_history(probe_params, params);
+	}
+	restart_integration = false;
+
+	{
+		Profiler::Timer timer(profiler, Phase::stamp_rhs);
+		engine.stamp_rhs(params);
+	}
+	{
+		Profiler::Timer timer(profiler, Phase::solve);
+		lu_update.solve(engine.get_system_rhs());
+	}
+}
+
+void Circuit::update(size_t step) {
+	const StampParams params = make_stamp_params(timestep, step);
+
+	prepare_solver(params, 0);
+	solve_step(params);
+
+	{
+		Profiler::Timer timer(profiler, Phase::update_parts);
+		engine.update(params);
+		// the events nearest to the end of the step
+		engine.apply_events((step + 1.5) * timestep);
+	}
+}
+
+void Circuit::run_adaptive(size_t num_steps, size_t &step, scalar &t) {
+	// Time counts in ticks of the smallest step, the step of a level starts at a multiple of its length,
+	// so the steps land on every output time. The events land on the tick nearest to their time.
+	const int min_level = std::clamp(static_cast<int>(std::floor(std::log2(adaptive_min_timestep / timestep))), -30, 0);
+	const int max_level = std::clamp(static_cast<int>(std::floor(std::log2(adaptive_max_timestep / timestep))), min_level, 30);
+
+	const uint64_t ticks_per_step = uint64_t(1) << -min_level;
+	const uint64_t end_tick = num_steps * ticks_per_step;
+	const scalar tick_length = std::ldexp(timestep, min_level);
+
+	const int order = integration_coefficients(integration_method).order;
+
+	uint64_t tick = 0;
+	int level = min_level;
+
+	// the events land on the nearest tick
+	engine.apply_events(0.5 * tick_length);
+
+	scope_values.resize(scopes.size());
+	for (size_t i = 0; i < scopes.size(); ++i) {
+		scope_values[i] = scopes[i]->read();
+	}
+
+	// the profiled step is the accepted one, it includes the rejected attempts before it
+	bool retrying = false;
+
+	while (tick < end_tick) {
+		if (!retrying) profiler.begin_step();
+		retrying = false;
+
+		uint64_t limit = end_tick;
+		const scalar event_time = engine.next_event_time();
+		if (event_time < end_tick * tick_length) {
+			limit = std::max(tick + 1, static_cast<uint64_t>(std::llround(event_time / tick_length)));
+		}
+
+		level = std::min(level, max_level);
+		while (level > min_level) {
+			const uint64_t length = uint64_t(1) << (level - min_level);
+			if (tick % length == 0 && tick + length <= limit) break;
+			--level;
+		}
+
+		const uint64_t length = uint64_t(1) << (level - min_level);
+		const uint64_t end = tick + length;
+		const StampParams params = make_stamp_params(std::ldexp(timestep, level), end / ticks_per_step);
+
+		prepare_solver(params, level);
+		const bool restarted = restart_integration;
+		solve_step(params);
+
+		const scalar ratio = engine.error_ratio(params, adaptive_tolerance);
+		// the step that would keep the error at the tolerance, with some margin
+		const scalar growth = 0.9 * std::pow(std::max(ratio, scalar(1e-12)), scalar(-1.0) / (order + 1));
+
+		if (ratio > 1.0 && level > min_level) {
+			level = std::max(min_level, level - std::max(1, static_cast<int>(std::ceil(-std::log2(growth)))));
+			restart_integration = restarted;
+			++stats.rejected_steps;
+			retrying = true;
+			continue;
+		}
+
+		{
+			Profiler::Timer timer(profiler, Phase::update_parts);
+			engine.update(params);
+			engine.apply_events((end + 0.5) * tick_length);
+		}
+		++stats.adaptive_steps;
+
+		{
+			Profiler::Timer timer(profiler, Phase::record_scopes);
+
+			for (; step < num_steps && (step + 1) * ticks_per_step <= end; ++step) {
+				const scalar weight = static_cast<scalar>((step + 1) * ticks_per_step - tick) / length;
+				t = step * timestep;
+
+				bool ready = false;
+				for (size_t i = 0; i < scopes.size(); ++i) {
+					const scalar value = scopes[i]->read();
+					ready = scopes[i]->decimate(scope_values[i] + weight * (value - scope_values[i]));
+				}
+				if (ready) record_sample(t);
+			}
+
+			for (size_t i = 0; i < scopes.size(); ++i) {
+				scope_values[i] = scopes[i]->read();
+			}
+		}
+
+		tick = end;
+		if (growth >= 2.0) ++level;
+
+		profiler.end_step();
 	}
 }
 
 void Circuit::run_for_steps(size_t num_steps) {
-	// TODO: do LU decomposition
+	if (!compiled) {
+		throw std::runtime_error("The circuit must be compiled before running, call Circuit::compile()");
+	}
 
 	std::cout << "Running for " << num_steps << " steps\n";
 
 	size_t step = 0;
 	scalar t = 0;
 
+	profiler.reset();
+
+	if (start_from_operating_point && needs_operating_point) solve_operating_point();
+
+	// the samples go to it until finish
+	if (stream_tables && !scopes.empty()) {
+		table_writer = std::make_unique<ScopeWriter>(scope_export_path / "scopes.csv", scopes, tables_started);
+		tables_started = true;
+	}
+
 	try {
+		// records all the steps, the loop below has nothing left to do
+		if (is_adaptive()) run_adaptive(num_steps, step, t);
+		// the events nearest to the start apply before the first step
+		else engine.apply_events(0.5 * timestep);
+
 		for (; step < num_steps; ++step) {
+			profiler.begin_step();
 			update(step);
 
-			for (const auto &scope : scopes) {
-				scope->record(t);
+			{
+				Profiler::Timer timer(profiler, Phase::record_scopes);
+				// the scopes decimate together, all of them have a sample or none
+				bool ready = false;
+				for (const auto &scope : scopes) {
+					ready = scope->decimate();
+				}
+				if (ready) record_sample(t);
 			}
 
-			t += timestep;
+			profiler.end_step();
+			t = (step + 1) * timestep;
 		}
 	}
 	catch (const lingebra::singular_matrix_exception &) {
 		std::cout << "Singular matrix encountered at time=" << t << "(step=" << step << ")\n";
 	}
+
+	if (table_writer) {
+		// the writer goes away even if the table failed
+		const std::unique_ptr<ScopeWriter> writer = std::move(table_writer);
+		writer->finish();
+		copy_to_latest("scopes.csv");
+
+		std::cout << "Wrote the table " << writer->get_path() << "\n";
+		if (writer->get_stalls() > 0) std::cout << "The simulation waited for the disk " << writer->get_stalls() << " times\n";
+	}
+
+	if (is_adaptive()) std::cout << "Took " << stats.adaptive_steps << " adaptive steps, " << stats.rejected_steps << " rejected\n";
+	if (factorizations.get_hits() + factorizations.get_misses() != 0) report_factorization_cache();
+	if constexpr (Profiler::enabled) export_profile();
+}
+
+void Circuit::record_sample(scalar t) {
+	// the decimated sample belongs to the state the filter is centered on
+	timebase.append(t - Decimator::delay(oversampling) * timestep);
+
+	if (table_writer) {
+		table_writer->write_row(timebase, scopes);
+		return;
+	}
+
+	for (const auto &scope : scopes) {
+		scope->keep_output();
+	}
+}
+
+void Circuit::clear_tables() {
+	timebase = { .period = timestep * oversampling };
+	// a streamed table starts again too
+	tables_started = false;
+	for (auto &scope : scopes) {
+		scope->clear();
+	}
+}
+
+void Circuit::copy_to_latest(const fs::path &filename) const {
+	const fs::path latest = scope_export_path.parent_path() / "latest" / filename;
+
+	fs::remove(latest);
+	fs::copy_file(scope_export_path / filename, latest);
+}
+
+void Circuit::export_profile() const {
+	const fs::path filename = "profile.json";
+	const fs::path filepath = scope_export_path / filename;
+
+	profiler.export_json(filepath, {
+		{ "rows", num_rows },
+		{ "lu_nnz", lu.nnz() },
+		{ "factorizations", stats.factorizations },
+		{ "low_rank_updates", stats.low_rank_updates },
+		{ "cache_hits", stats.cache_hits },
+		{ "adaptive_steps", stats.adaptive_steps },
+		{ "rejected_steps", stats.rejected_steps },
+	});
+
+	copy_to_latest(filename);
+
+	std::cout << "Exported profile " << filepath << "\n";
+}
+
+void Circuit::render_frame(std::span<scalar> frame) {
+	if (!compiled) {
+		throw std::runtime_error("The circuit must be compiled before rendering, call Circuit::compile()");
+	}
+
+	if (!processing_prepared) prepare_processing();
+	apply_parameter_changes(oversampling);
+
+	// the decimators are in sync, all of them have an output after the same step
+	bool ready = false;
+	size_t steps = 0;
+
+	while (!ready) {
+		advance_parameter_ramps(1, false);
+		update(render_step++);
+		++steps;
+
+		ready = scopes.empty() ? steps == oversampling : true;
+		for (size_t i = 0; i < scopes.size(); ++i) {
+			if (!scopes[i]->decimate()) ready = false;
+		}
+	}
+
+	for (size_t i = 0; i < scopes.size(); ++i) {
+		frame[i] = scopes[i]->get_output();
+	}
+}
+
+bool Circuit::cache_scheduled_states() {
+	const auto pending = engine.events.pending();
+	if (pending.empty()) return true;
+	if (!cache_factorizations) return false;
+
+	const size_t evictions = factorizations.get_evictions();
+	const std::vector<uint8_t> initial_state = engine.switches.on;
+	const StampParams params = make_stamp_params(timestep, 0);
+	bool all_cached = true;
+
+	for (const Event &event : pending) {
+		engine.switches.apply(event);
+		get_factorization_key(switch_state, 0);
+		if (factorizations.contains(switch_state)) continue;
+
+		stamp_matrix(params);
+		Profiler::Timer timer(profiler, Phase::factorize);
+		try {
+			lu.factorize(matrix);
+		}
+		catch (const lingebra::singular_matrix_exception &) {
+			// process stops when it gets there
+			all_cached = false;
+			continue;
+		}
+		++stats.factorizations;
+
+		if (!factorizations.insert(switch_state, lu)) {
+			cache_factorizations = false;
+			break;
+		}
+	}
+
+	// back to the factorization of the current state, which is in the cache unless it was evicted
+	engine.switches.on = initial_state;
+	get_factorization_key(switch_state, 0);
+
+	if (const auto *cached = cache_factorizations ? factorizations.find(switch_state) : nullptr) {
+		lu_update.reset(*cached);
+		engine.mark_stamped();
+	}
+	else {
+		needs_factorization = true;
+		prepare_solver(params, 0);
+	}
+
+	return all_cached && cache_factorizations && factorizations.get_evictions() == evictions;
+}
+
+bool Circuit::prepare_processing() {
+	if (!compiled) {
+		throw std::runtime_error("The circuit must be compiled before processing, call Circuit::compile()");
+	}
+
+	if (start_from_operating_point && needs_operating_point) solve_operating_point();
+	// the events nearest to the start apply before the first step
+	engine.apply_events(0.5 * timestep);
+
+	prepare_solver(make_stamp_params(timestep, 0), 0);
+
+	for (auto &input : process_inputs) {
+		input.last = 0.0;
+	}
+
+	processing_prepared = true;
+	return cache_scheduled_states();
+}
+
+void Circuit::process(const float *const *inputs, float *const *outputs, size_t frames) noexcept {
+	size_t frame = 0;
+
+	if (processing_prepared && !process_error) {
+		apply_parameter_changes(frames * oversampling);
+
+		try {
+			for (; frame < frames; ++frame) {
+				for (size_t s = 1; s <= oversampling; ++s) {
+					const scalar weight = static_cast<scalar>(s) / oversampling;
+					advance_parameter_ramps(1, false);
+
+					for (size_t k = 0; k < process_inputs.size(); ++k) {
+						const ProcessInput &input = process_inputs[k];
+						const scalar sample = input.last + weight * (inputs[k][frame] - input.last);
+						engine.voltage_sources.voltage[input.batch_id] = input.offset + input.gain * sample;
+					}
+
+					update(render_step++);
+
+					for (auto &output : process_outputs) {
+						output.probe->decimate();
+					}
+				}
+
+				for (size_t k = 0; k < process_inputs.size(); ++k) {
+					process_inputs[k].last = inputs[k][frame];
+				}
+				for (size_t k = 0; k < process_outputs.size(); ++k) {
+					outputs[k][frame] = static_cast<float>(process_outputs[k].gain * process_outputs[k].probe->get_output());
+				}
+			}
+		}
+		catch (const lingebra::singular_matrix_exception &) {
+			process_error = true;
+		}
+	}
+
+	for (size_t k = 0; k < process_outputs.size(); ++k) {
+		std::fill(outputs[k] + frame, outputs[k] + frames, 0.0f);
+	}
+}
+
+Parameter Circuit::get_parameter(const std::string &part_name) const {
+	if (!compiled) {
+		throw std::runtime_error("The circuit must be compiled before getting a parameter, call Circuit::compile()");
+	}
+
+	const auto it = std::find_if(parts.begin(), parts.end(), [&](const auto &part) { return part->get_name() == part_name; });
+	if (it == parts.end()) {
+		throw std::runtime_error(std::format("No part named {}", part_name));
+	}
+
+	const std::optional<Parameter> parameter = (*it)->get_parameter();
+	if (!parameter) {
+		throw std::runtime_error(std::format("The part {} has no value that can change", part_name));
+	}
+	return *parameter;
+}
+
+void Circuit::set_parameter(const Parameter &parameter, scalar value) noexcept {
+	engine.set_parameter(parameter, value);
+
+	if (parameter.kind == ParameterKind::voltage) {
+		// process adds the input to the value
+		for (auto &input : process_inputs) {
+			if (input.batch_id == parameter.batch_id) input.offset = value;
+		}
+	}
+
+	if (changes_matrix(parameter.kind)) {
+		// the cached factorizations are of the old values
+		needs_factorization = true;
+		factorizations.clear();
+	}
+}
+
+scalar Circuit::get_parameter(const Parameter &parameter) const noexcept {
+	if (parameter.kind == ParameterKind::voltage) {
+		for (const auto &input : process_inputs) {
+			if (input.batch_id == parameter.batch_id) return input.offset;
+		}
+	}
+
+	return engine.get_parameter(parameter);
+}
+
+void Circuit::start_parameter_ramp(const ParameterChange &change) noexcept {
+	const Parameter &parameter = change.parameter;
+
+	auto ramp = std::find_if(parameter_ramps.begin(), parameter_ramps.end(), [&](const ParameterRamp &r) {
+		return r.parameter.kind == parameter.kind && r.parameter.batch_id == parameter.batch_id;
+	});
+
+	const size_t steps = change.smoothing_time > 0.0 ? std::max<size_t>(1, std::llround(change.smoothing_time / timestep)) : 0;
+
+	if (steps == 0) {
+		if (ramp != parameter_ramps.end()) {
+			*ramp = parameter_ramps.back();
+			parameter_ramps.pop_back();
+		}
+		set_parameter(parameter, change.value);
+		return;
+	}
+
+	const scalar value = get_parameter(parameter);
+	const ParameterRamp started{ .parameter = parameter, .target = change.value, .delta = (change.value - value) / steps, .remaining = steps };
+
+	// at most one ramp per part, the capacity holds all of them
+	if (ramp != parameter_ramps.end()) *ramp = started;
+	else parameter_ramps.push_back(started);
+}
+
+void Circuit::advance_parameter_ramps(size_t steps, bool matrix_values) noexcept {
+	for (size_t i = 0; i < parameter_ramps.size();) {
+		ParameterRamp &ramp = parameter_ramps[i];
+
+		if (changes_matrix(ramp.parameter.kind) != matrix_values) {
+			++i;
+			continue;
+		}
+
+		ramp.remaining -= std::min(steps, ramp.remaining);
+		set_parameter(ramp.parameter, ramp.target - ramp.remaining * ramp.delta);
+
+		if (ramp.remaining == 0) {
+			ramp = parameter_ramps.back();
+			parameter_ramps.pop_back();
+		}
+		else {
+			++i;
+		}
+	}
+}
+
+void Circuit::apply_parameter_changes(size_t block_steps) noexcept {
+	std::array<ParameterChange, 16> changes;
+
+	while (const size_t count = parameter_changes.take(changes)) {
+		for (size_t i = 0; i < count; ++i) {
+			start_parameter_ramp(changes[i]);
+		}
+	}
+
+	// the matrix values jump to the end of the block
+	advance_parameter_ramps(block_steps, true);
 }
 
 void Circuit::run_for_seconds(scalar secs) {
-	run_for_steps(static_cast<size_t>(secs / timestep));
+	// the decimation delays the tables, run until they reach secs
+	const size_t num_samples = static_cast<size_t>(std::llround(secs * get_samplerate()));
+	run_for_steps(num_samples * oversampling + Decimator::delay(oversampling));
+}
+
+void Circuit::set_timestep(scalar dt) {
+	timestep = dt;
+	needs_factorization = true;
+	restart_integration = true;
+	factorizations.clear();
+
+	for (auto &scope : scopes) {
+		scope->set_decimation(oversampling);
+	}
+	for (auto &output : process_outputs) {
+		output.probe->set_decimation(oversampling);
+	}
+	// the recorded samples are of the old samplerate
+	clear_tables();
+}
+
+void Circuit::set_oversampling(size_t factor) {
+	if (factor == 0) throw std::runtime_error("The oversampling factor must be positive");
+
+	oversampling = factor;
+
+	for (auto &scope : scopes) {
+		scope->set_decimation(oversampling);
+	}
+	for (auto &output : process_outputs) {
+		output.probe->set_decimation(oversampling);
+	}
+	// the recorded samples are of the old samplerate
+	clear_tables();
 }
 
 // scopes
+void Circuit::setup_scope(Scope &scope) {
+	if (compiled) scope.bind(engine.get_solution());
+	scope.set_decimation(oversampling);
+}
+
 void Circuit::scope_voltage(const ConstPin &a, const ConstPin &b) {
-	scopes.push_back(std::make_unique<VoltageScope>(a, b, scope_export_path));
+	scopes.push_back(std::make_unique<VoltageScope>(a, b));
+	setup_scope(*scopes.back());
+	// a table has the same samples in every column
+	clear_tables();
 }
 
 void Circuit::scope_current(const ConstPin &a, const ConstPin &b) {
-	scopes.push_back(std::make_unique<CurrentScope>(a, b, scope_export_path));
+	scopes.push_back(std::make_unique<CurrentScope>(a, b));
+	setup_scope(*scopes.back());
+	clear_tables();
+}
+
+// process channels
+void Circuit::add_input(VoltageSource *source, scalar gain) {
+	process_inputs.push_back({ .source = source, .gain = gain });
+	compiled = false;
+}
+
+void Circuit::add_input(VoltageSource2Pin *source, scalar gain) {
+	process_inputs.push_back({ .source = source, .gain = gain });
+	compiled = false;
+}
+
+void Circuit::output_voltage(const ConstPin &a, const ConstPin &b, scalar gain) {
+	process_outputs.push_back({ std::make_unique<VoltageScope>(a, b), gain });
+	setup_scope(*process_outputs.back().probe);
+}
+
+void Circuit::output_current(const ConstPin &a, const ConstPin &b, scalar gain) {
+	process_outputs.push_back({ std::make_unique<CurrentScope>(a, b), gain });
+	setup_scope(*process_outputs.back().probe);
 }
 
 void Circuit::export_tables() const {
+	if (stream_tables) {
+		std::cout << "The tables were written while running\n";
+		return;
+	}
+
 	std::cout << "Exporting tables...\n";
 
+	if (table_format == TableFormat::binary) {
+		export_binary_table();
+		return;
+	}
+
+	const fs::path filename = "scopes.csv";
+	write_csv_table(scope_export_path / filename, timebase.start, timebase.period, get_table_columns());
+	copy_to_latest(filename);
+
+	std::cout << "Exported " << scopes.size() << " scopes to " << scope_export_path / filename << "\n";
+}
+
+std::vector<TableColumn> Circuit::get_table_columns() const {
+	std::vector<TableColumn> columns;
 	for (const auto &scope : scopes) {
-		scope->export_table();
+		columns.push_back({ .name = scope->get_name(), .unit = scope->get_unit(), .values = scope->get_values() });
 	}
+	return columns;
+}
+
+void Circuit::export_binary_table() const {
+	const fs::path filename = "scopes.slt";
+	const fs::path filepath = scope_export_path / filename;
+
+	write_table(filepath, timebase.start, timebase.period, get_table_columns());
+	copy_to_latest(filename);
+
+	std::cout << "Exported " << scopes.size() << " scopes to " << filepath << "\n";
 }
 
 void Circuit::show_graphs() const {
+	if (stream_tables) {
+		std::cout << "The graphs need the recorded tables, they were written while running\n";
+		return;
+	}
+
 	using sciplot::PlotVariant;
 	using sciplot::Plot2D;
 	using sciplot::Figure;
@@ -189,7 +987,7 @@ void Circuit::show_graphs() const {
 	std::vector<std::vector<PlotVariant>> plot_grid(h, std::vector<PlotVariant>(w));
 
 	for (size_t i = 0; i < n; ++i) {
-		scopes[i]->plot(std::get<Plot2D>(plot_grid[i / w][i % w]));
+		scopes[i]->plot(std::get<Plot2D>(plot_grid[i / w][i % w]), timebase);
 	}
 
 	Figure figure(plot_grid);
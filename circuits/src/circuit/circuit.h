@@ -1,21 +1,80 @@
 #pragma once
 
 #include "../lingebra/lingebra.h"
+#include "decimator.h"
+#include "engine.h"
+#include "factorization_cache.h"
 #include "n_pin_part.h"
 #include "node.h"
+#include "parameter.h"
 #include "part.h"
 #include "parts/voltage_source.h"
 #include "pin.h"
+#include "profiler.h"
 #include "scalar.h"
 #include "scope.h"
+#include "table_file.h"
+#include "stamp_pattern.h"
 #include <filesystem>
 #include <memory>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
 
 class Interpreter;
+class ScopeWriter;
+
+class CompileError : public std::runtime_error {
+public:
+	explicit CompileError(const std::string &message)
+		: std::runtime_error(message) {}
+};
+
+// counters of the solver since the last compile
+struct SolverStats {
+	size_t num_rows = 0;
+	size_t matrix_nnz = 0;
+	size_t predicted_lu_nnz = 0;
+	size_t lu_nnz = 0;
+	size_t lu_bytes = 0;
+	size_t factorizations = 0;
+	size_t low_rank_updates = 0;
+	size_t cache_hits = 0;
+	// steps of the adaptive stepping, the rejected ones were solved again with a smaller timestep
+	size_t adaptive_steps = 0;
+	size_t rejected_steps = 0;
+};
+
+// a voltage source driven by an input channel of Circuit::process, the channel times gain adds to its voltage
+struct ProcessInput {
+	Part *source;
+	scalar gain;
+
+	// set by compile
+	size_t batch_id = 0;
+	scalar offset = 0.0;
+
+	// the sample of the previous frame, the steps of a frame interpolate from it
+	scalar last = 0.0;
+};
+
+// a voltage or current written to an output channel of Circuit::process, decimated like the scopes
+struct ProcessOutput {
+	std::unique_ptr<Scope> probe;
+	scalar gain;
+};
+
+// a parameter on the way to its target, remaining steps of delta each are left
+struct ParameterRamp {
+	Parameter parameter;
+	scalar target;
+	scalar delta;
+	size_t remaining;
+};
 
 class Circuit {
 private:
@@ -25,18 +84,148 @@ private:
 	VoltageSource *ground;
 
 	std::vector<std::unique_ptr<Scope>> scopes;
+	// the times of the samples of the scopes
+	Timebase timebase;
+
+	// the channels of process
+	std::vector<ProcessInput> process_inputs;
+	std::vector<ProcessOutput> process_outputs;
 
 	scalar timestep;
+	// the scopes decimate the steps by this factor
+	size_t oversampling = 1;
+	IntegrationMethod integration_method = IntegrationMethod::backward_euler;
 	fs::path scope_export_path;
 
+	// runtime state built by compile(), invalidated by any topology change
+	bool compiled = false;
+	size_t num_rows = 0;
+
+	// the parts grouped by type, stamps and updates them every step
+	Engine engine;
+
+	// matrix with the structure reserved by the parts, values are written only on factorization
+	lingebra::SparseMatrix<scalar> matrix;
+	// index into matrix.values() of every stamp slot except the discarded one
+	std::vector<size_t> slot_value_ids;
+
+	// factorization of the last stamped matrix, reused until a part changes its stamp
+	lingebra::SparseLU<scalar> lu;
+	bool needs_factorization = true;
+
+	// the next step rebuilds the integration history, set at the start and after every switch toggle
+	bool restart_integration = true;
+	// steps rendered by render_frame or process since compile
+	size_t render_step = 0;
+	bool processing_prepared = false;
+	// a singular matrix stopped the processing
+	bool process_error = false;
+
+	// the solver reports go to the standard output
+	bool verbose = true;
+
+	// the runs write the tables as they record instead of keeping them for export_tables
+	bool stream_tables = false;
+	// a run already started the tables, the next one appends to them
+	bool tables_started = false;
+	// set while a streaming run writes the table
+	std::unique_ptr<ScopeWriter> table_writer;
+	TableFormat table_format = TableFormat::csv;
+
+	// posted by a control thread, applied by process and render_frame at the block boundaries
+	ParameterQueue parameter_changes;
+	// the sources ramp every step, the matrix values once per block, so a sweep factorizes once per block.
+	// Reserved for every part by compile, so starting a ramp does not allocate.
+	std::vector<ParameterRamp> parameter_ramps;
+
+	// the first run starts from the DC operating point instead of from rest
+	bool start_from_operating_point = false;
+	bool needs_operating_point = true;
+	// the timestep the integration history of the reactive parts was taken with
+	scalar history_timestep = 0.0;
+
+	// Adaptive stepping takes steps of timestep * 2^level, the levels are limited by the bounds,
+	// the matrix of the solver was stamped with stamped_level. Off while adaptive_max_timestep is 0.
+	scalar adaptive_min_timestep = 0.0;
+	scalar adaptive_max_timestep = 0.0;
+	scalar adaptive_tolerance = 1e-3;
+	int stamped_level = 0;
+	// value of every scope at the start of the adaptive step, interpolated to the output times
+	std::vector<scalar> scope_values;
+
+	// switch toggles since the last factorization are solved with a low rank update of it
+	lingebra::DiagonalUpdate<scalar> lu_update;
+	std::vector<std::pair<size_t, scalar>> stamp_changes;
+	// with more changed entries than this the matrix is factorized again
+	static constexpr size_t max_update_rank = 8;
+
+	// factorizations by the switch state, revisiting a state costs only the lookup,
+	// the low rank updates are used when the cache is disabled or too small for one factorization
+	FactorizationCache factorizations;
+	FactorizationCache::Key switch_state;
+	bool cache_factorizations = true;
+
+	// entries of L and U predicted for the fill-reducing and the natural column order,
+	// reported with the actual count after the first factorization
+	size_t predicted_lu_nnz = 0;
+	size_t natural_lu_nnz = 0;
+	bool fill_reported = false;
+
+	SolverStats stats;
+
+	// phase timings of the last run, only with SIMLOGUE_PROFILE
+	Profiler profiler;
+
 
 	Node *create_new_node();
 
-	lingebra::Matrix<scalar> build_matrix(const StampParams &params) const;
+	void validate() const;
+	void stamp_matrix(const StampParams &params);
+	void report_fill() const;
+	void report_factorization_cache() const;
+	void export_profile() const;
+	void export_binary_table() const;
+	std::vector<TableColumn> get_table_columns() const;
+	// copies the file of the run to latest
+	void copy_to_latest(const fs::path &filename) const;
+
+	// the switch state and with the adaptive stepping the level
+	void get_factorization_key(FactorizationCache::Key &key, int level) const;
+	// makes the solver use the matrix of the current switch state stamped for the level
+	void prepare_solver(const StampParams &params, int level);
+	// solves the step into the engine solution, the parts are not updated
+	void solve_step(const StampParams &params);
+	StampParams make_stamp_params(scalar dt, size_t step) const;
+
+	// binds the scope when compiled and sets its decimation
+	void setup_scope(Scope &scope);
+	// the scopes have a new sample at the time of the state t, appends it to the timebase and the tables
+	void record_sample(scalar t);
+	// drops the recorded samples, the timebase starts again
+	void clear_tables();
+
 	void update(size_t step);
+	// factorizes the matrix of every switch state the scheduled events lead to into the cache,
+	// returns false if some of them do not fit
+	bool cache_scheduled_states();
+
+	// takes the posted changes and moves the matrix values to the end of the block of block_steps steps
+	void apply_parameter_changes(size_t block_steps) noexcept;
+	void start_parameter_ramp(const ParameterChange &change) noexcept;
+	// moves the ramps of the matrix values or of the sources by the steps, drops the finished ones
+	void advance_parameter_ramps(size_t steps, bool matrix_values) noexcept;
+	void set_parameter(const Parameter &parameter, scalar value) noexcept;
+	// the value set_parameter set, without the input process adds to a source
+	scalar get_parameter(const Parameter &parameter) const noexcept;
+	// runs all the steps, step and t follow the recorded steps
+	void run_adaptive(size_t num_steps, size_t &step, scalar &t);
 
 	std::unique_ptr<class Interpreter> interpreter;
 
+	// copies the compiled state into its voices
+	template <size_t Voices>
+	friend class Polyphony;
+
 public:
 	Circuit(scalar timestep, const fs::path &scope_export_path = "./");
 	~Circuit() noexcept;
@@ -48,6 +237,7 @@ public:
 		auto part = std::make_unique<TPart>(std::forward<TArgs>(args)...);
 		TPart *raw = part.get();
 		parts.push_back(std::move(part));
+		compiled = false;
 
 		return raw;
 	}
@@ -56,9 +246,19 @@ public:
 
 	void connect(const Pin &pin_a, const Pin &pin_b);
 
-	inline void set_timestep(scalar dt) { timestep = dt; }
+	void set_timestep(scalar dt);
 	inline scalar get_timestep() const { return timestep; }
 
+	// The scopes record every factor-th step through a polyphase anti-aliasing filter, so the tables
+	// have the samplerate 1 / (timestep * factor). Resets the filters of the scopes.
+	void set_oversampling(size_t factor);
+	inline size_t get_oversampling() const { return oversampling; }
+	inline scalar get_samplerate() const { return 1.0 / (timestep * oversampling); }
+
+	// companion model of the capacitors and inductors, backward euler by default
+	inline void set_integration_method(IntegrationMethod method) { integration_method = method; needs_factorization = true; restart_integration = true; factorizations.clear(); }
+	inline IntegrationMethod get_integration_method() const { return integration_method; }
+
 	void scope_voltage(const ConstPin &a, const ConstPin &b);
 	// Pin a and b must be of the same part or the single pin voltage source and ground pin
 	void scope_current(const ConstPin &a, const ConstPin &b);
@@ -69,11 +269,108 @@ public:
 		scope_current(part->pin(0), get_ground()->pin(0));
 	}
 
+	// one table of all the scopes, a column for each
 	void export_tables() const;
 	void show_graphs() const;
+	inline const Timebase &get_timebase() const { return timebase; }
+
+	// what export_tables writes, the binary table can be read by TableReader
+	inline void set_table_format(TableFormat format) { table_format = format; }
+	inline TableFormat get_table_format() const { return table_format; }
+
+	/* The runs write the scope tables while they record, on a background thread with a fixed amount of memory,
+	 * instead of keeping the whole run for export_tables. The next runs append to the tables. The graphs need
+	 * the recorded values, there are none then. */
+	inline void set_stream_tables(bool enabled) { stream_tables = enabled; }
+	inline bool is_streaming_tables() const { return stream_tables; }
 
 	void load_circuit(const fs::path &script);
 
+	// Validates the netlist, assigns the matrix rows and builds the runtime state.
+	// Must be called after the last topology change (add_part, connect) and before running.
+	// throws CompileError
+	void compile();
+	inline bool is_compiled() const { return compiled; }
+
+	// valid after compile
+	SolverStats get_solver_stats() const;
+
+	// The streaming counterpart of run_for_steps: advances by one sample of the samplerate with fixed steps
+	// and writes the decimated value of every scope to frame, in the order the scopes were added.
+	// The scopes record nothing, so the memory stays bounded. Do not mix with run_for_steps.
+	// throws lingebra::singular_matrix_exception
+	void render_frame(std::span<scalar> frame);
+	inline size_t get_num_scopes() const { return scopes.size(); }
+
+	// The source follows the input channel of process times gain on top of its own voltage, the channels
+	// are numbered in the order of the calls. A single pin source must not be connected to the ground.
+	void add_input(VoltageSource *source, scalar gain = 1.0);
+	void add_input(VoltageSource2Pin *source, scalar gain = 1.0);
+	// the output channels of process, numbered in the order of the calls
+	void output_voltage(const ConstPin &a, const ConstPin &b, scalar gain = 1.0);
+	// Pin a and b must be of the same part or the single pin voltage source and ground pin
+	void output_current(const ConstPin &a, const ConstPin &b, scalar gain = 1.0);
+	inline size_t get_num_inputs() const { return process_inputs.size(); }
+	inline size_t get_num_outputs() const { return process_outputs.size(); }
+
+	// Does everything process must not do: the operating point, the first factorization and the factorizations
+	// of the switch states the scheduled events lead to, which go to the factorization cache. Call after compile,
+	// outside of the audio thread. Returns false if the cache cannot hold all the states, process then
+	// factorizes or updates the matrix when a switch toggles, which allocates.
+	// throws lingebra::singular_matrix_exception
+	bool prepare_processing();
+
+	/* Advances by frames samples of the samplerate with fixed steps, for embedding in an audio host.
+	 * inputs[k][frame] drives the input k, the steps of a frame interpolate it linearly from the
+	 * previous frame. outputs[k][frame] receives the output k, decimated like the scopes, so it is
+	 * get_latency() frames late. Allocates nothing, does no I/O and takes no locks once prepare_processing
+	 * returned true, unless a matrix parameter changes. The scopes record nothing. Writes silence if not prepared or after a singular matrix.
+	 * Do not mix with run_for_steps and render_frame. */
+	void process(const float *const *inputs, float *const *outputs, size_t frames) noexcept;
+	// in frames
+	inline size_t get_latency() const noexcept { return Decimator::delay(oversampling) / oversampling; }
+	// a singular matrix stopped the processing until the next compile
+	inline bool has_process_error() const noexcept { return process_error; }
+
+	// the solver reports go to the standard output, on by default
+	inline void set_verbose(bool enabled) { verbose = enabled; }
+
+	// The handle of the value of the part, valid until the next compile.
+	// throws std::runtime_error if the circuit is not compiled or the part has no value
+	Parameter get_parameter(const std::string &part_name) const;
+	/* Called by one control thread while process or render_frame runs on another, lock-free.
+	 * The value applies at the start of the next block, ramping linearly over smoothing_time seconds.
+	 * Source values change only the RHS, resistance, capacitance and inductance factorize the matrix
+	 * once per block while they change and drop the cached factorizations. Returns false if the queue is full. */
+	inline bool post_parameter(const Parameter &parameter, scalar value, scalar smoothing_time = 0.0) noexcept {
+		return parameter_changes.post({ .parameter = parameter, .value = value, .smoothing_time = smoothing_time });
+	}
+
+	// Solves the DC operating point with the current switch states and starts the parts from it,
+	// the capacitors hold their voltages and the inductors their currents. Call after compile,
+	// returns false and keeps the state if the DC matrix is singular.
+	bool solve_operating_point();
+	// the first run after compile starts from the operating point, off by default
+	inline void set_start_from_operating_point(bool enabled) { start_from_operating_point = enabled; }
+
+	// Steps between min_timestep and max_timestep, both rounded down to timestep times a power of two,
+	// keeping the estimated local truncation error of the capacitor voltages and inductor currents
+	// below tolerance relative to their values. The scopes are still recorded every timestep,
+	// interpolated between the steps.
+	void set_adaptive_timestep(scalar min_timestep, scalar max_timestep, scalar tolerance = 1e-3);
+	void disable_adaptive_timestep();
+	inline bool is_adaptive() const { return adaptive_max_timestep > 0.0; }
+
+	// timings of the last run, empty unless built with SIMLOGUE_PROFILE
+	inline const Profiler &get_profiler() const { return profiler; }
+
+	// memory budget of the cached factorizations, 0 disables the cache
+	void set_factorization_cache_budget(size_t bytes);
+	inline const FactorizationCache &get_factorization_cache() const { return factorizations; }
+
+	// valid after compile
+	inline scalar get_voltage(const Node &node) const { return engine.get_value(node.node_id); }
+
 	void run_for_steps(size_t num_steps);
 	void run_for_seconds(scalar secs);
 
@@ -0,0 +1,81 @@
+#include "decimator.h"
+
+#include "scalar.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <vector>
+
+
+Decimator::Decimator(size_t factor) : factor(factor) {
+	if (factor == 1) return;
+
+	// the low-pass has 2 * delay + 1 taps centered on the delay, the phases pad it with zeros
+	const size_t delay = get_delay();
+	const size_t num_taps = 2 * delay + 1;
+	const double fc = 0.5 * cutoff / factor;
+	const double i0_beta = std::cyl_bessel_i(0.0, static_cast<double>(kaiser_beta));
+
+	std::vector<double> taps(factor * taps_per_phase, 0.0);
+	for (size_t k = 0; k < num_taps; ++k) {
+		const double x = static_cast<double>(k) - static_cast<double>(delay);
+		const double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * std::numbers::pi * fc * x) / (2.0 * std::numbers::pi * fc * x);
+		const double r = x / static_cast<double>(delay);
+		const double window = std::cyl_bessel_i(0.0, kaiser_beta * std::sqrt(1.0 - r * r)) / i0_beta;
+		taps[k] = sinc * window;
+	}
+
+	// unit gain at DC
+	const double sum = std::accumulate(taps.begin(), taps.end(), 0.0);
+
+	coefficients.resize(taps.size());
+	for (size_t p = 0; p < factor; ++p) {
+		for (size_t j = 0; j < taps_per_phase; ++j) {
+			coefficients[p * taps_per_phase + j] = static_cast<scalar>(taps[p + factor * j] / sum);
+		}
+	}
+
+	history.assign(factor * 2 * taps_per_phase, 0.0);
+}
+
+bool Decimator::push(scalar value) noexcept {
+	if (factor == 1) {
+		output = value;
+		return true;
+	}
+
+	if (!primed) {
+		std::fill(history.begin(), history.end(), value);
+		primed = true;
+	}
+
+	scalar *line = history.data() + phase * 2 * taps_per_phase;
+	line[head] = value;
+	line[head + taps_per_phase] = value;
+
+	if (phase > 0) {
+		--phase;
+		return false;
+	}
+
+	scalar sum = 0.0;
+	for (size_t p = 0; p < factor; ++p) {
+		const scalar *taps = coefficients.data() + p * taps_per_phase;
+		const scalar *samples = history.data() + p * 2 * taps_per_phase + head;
+
+		for (size_t j = 0; j < taps_per_phase; ++j) {
+			sum += taps[j] * samples[j];
+		}
+	}
+	output = sum;
+
+	head = head == 0 ? taps_per_phase - 1 : head - 1;
+	phase = factor - 1;
+
+	if (skipped < delay_blocks) {
+		++skipped;
+		return false;
+	}
+	return true;
+}
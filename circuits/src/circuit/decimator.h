@@ -0,0 +1,57 @@
+#pragma once
+
+#include "scalar.h"
+#include <cstddef>
+#include <vector>
+
+
+/* Polyphase FIR decimation by an integer factor. The low-pass is a Kaiser windowed sinc with
+ * the cutoff just below the output Nyquist frequency, it is split into factor phases of
+ * taps_per_phase taps, every input sample is multiplied only by the taps of its phase.
+ *
+ * The filter is symmetric with a delay of delay_blocks output samples, the first output
+ * belongs to the first input sample. The signal is taken as constant before the first sample,
+ * so a circuit starting in a steady state does not ring. A factor of 1 passes the samples through. */
+class Decimator {
+public:
+	// the delay in output samples, the transition band narrows with it
+	static constexpr size_t delay_blocks = 16;
+	static constexpr size_t taps_per_phase = 2 * delay_blocks + 1;
+
+	// of the output Nyquist frequency
+	static constexpr scalar cutoff = 0.9;
+	// about 80 dB of stopband attenuation
+	static constexpr scalar kaiser_beta = 8.0;
+
+private:
+	size_t factor = 1;
+
+	// coefficients[p * taps_per_phase + j] is the tap p + factor * j of the low-pass
+	std::vector<scalar> coefficients;
+	// the delay line of the phase p is history[p * 2 * taps_per_phase ..], doubled so that
+	// the taps_per_phase newest samples from head on are contiguous
+	std::vector<scalar> history;
+	size_t head = 0;
+
+	// the phase of the next input sample, its output is ready after the phase 0
+	size_t phase = 0;
+	// outputs of the warm up, they belong to the times before the first input
+	size_t skipped = 0;
+	bool primed = false;
+
+	scalar output = 0.0;
+
+public:
+	Decimator() = default;
+	explicit Decimator(size_t factor);
+
+	// in input samples
+	static constexpr size_t delay(size_t factor) noexcept { return factor == 1 ? 0 : delay_blocks * factor; }
+
+	inline size_t get_factor() const noexcept { return factor; }
+	inline size_t get_delay() const noexcept { return delay(factor); }
+
+	// true when an output sample is ready
+	bool push(scalar value) noexcept;
+	inline scalar get_output() const noexcept { return output; }
+};
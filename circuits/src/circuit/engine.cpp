@@ -0,0 +1,517 @@
+#include "engine.h"
+
+#include "scalar.h"
+#include "stamp_pattern.h"
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <utility>
+#include <vector>
+
+
+// Resistors
+
+size_t ResistorBatch::add(size_t node0, size_t node1, scalar conductance) {
+	this->node0.push_back(node0);
+	this->node1.push_back(node1);
+	this->conductance.push_back(conductance);
+	return this->conductance.size() - 1;
+}
+
+void ResistorBatch::reserve_matrix_entries(StampPattern &pattern) {
+	slots.resize(conductance.size());
+
+	for (size_t k = 0; k < slots.size(); ++k) {
+		slots[k] = {
+			pattern.reserve(node0[k], node0[k]),
+			pattern.reserve(node0[k], node1[k]),
+			pattern.reserve(node1[k], node0[k]),
+			pattern.reserve(node1[k], node1[k])
+		};
+	}
+}
+
+void ResistorBatch::stamp_matrix(std::vector<scalar> &entries, const StampParams &params) const {
+	for (size_t k = 0; k < slots.size(); ++k) {
+		entries[slots[k][0]] = conductance[k];
+		entries[slots[k][1]] = -conductance[k];
+		entries[slots[k][2]] = -conductance[k];
+		entries[slots[k][3]] = conductance[k];
+	}
+}
+
+
+// Capacitors
+
+size_t CapacitorBatch::add(size_t node0, size_t node1, scalar capacitance) {
+	this->node0.push_back(node0);
+	this->node1.push_back(node1);
+	this->capacitance.push_back(capacitance);
+	admittance.push_back(0.0);
+	last_v.push_back(0.0);
+	prev_v.push_back(0.0);
+	last_i.push_back(0.0);
+	return this->capacitance.size() - 1;
+}
+
+void CapacitorBatch::reserve_matrix_entries(StampPattern &pattern) {
+	slots.resize(capacitance.size());
+
+	for (size_t k = 0; k < slots.size(); ++k) {
+		slots[k] = {
+			pattern.reserve(node0[k], node0[k]),
+			pattern.reserve(node0[k], node1[k]),
+			pattern.reserve(node1[k], node0[k]),
+			pattern.reserve(node1[k], node1[k])
+		};
+	}
+}
+
+void CapacitorBatch::stamp_matrix(std::vector<scalar> &entries, const StampParams &params) {
+	const size_t n = capacitance.size();
+
+	for (size_t k = 0; k < n; ++k) {
+		admittance[k] = params.integration.a0 * capacitance[k] * params.timestep_inv;
+	}
+
+	for (size_t k = 0; k < n; ++k) {
+		entries[slots[k][0]] = admittance[k];
+		entries[slots[k][1]] = -admittance[k];
+		entries[slots[k][2]] = -admittance[k];
+		entries[slots[k][3]] = admittance[k];
+	}
+}
+
+// the current of the history source, i = admittance * v - history
+static inline scalar capacitor_history(const CapacitorBatch &batch, size_t k, const StampParams &params) {
+	const IntegrationCoefficients &c = params.integration;
+	return params.timestep_inv * batch.capacitance[k] * (-c.a1 * batch.last_v[k] - c.a2 * batch.prev_v[k]) + c.b1 * batch.last_i[k];
+}
+
+void CapacitorBatch::stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const {
+	for (size_t k = 0; k < capacitance.size(); ++k) {
+		const scalar value = capacitor_history(*this, k, params);
+		rhs[node0[k]] += value;
+		rhs[node1[k]] -= value;
+	}
+}
+
+void CapacitorBatch::update(std::span<const scalar> solution, const StampParams &params) {
+	const size_t n = capacitance.size();
+
+	for (size_t k = 0; k < n; ++k) {
+		// not the stamped admittance, a cached factorization may have been stamped with another timestep
+		const scalar step_admittance = params.integration.a0 * capacitance[k] * params.timestep_inv;
+		const scalar v_now = solution[node0[k]] - solution[node1[k]];
+		last_i[k] = step_admittance * v_now - capacitor_history(*this, k, params);
+		prev_v[k] = last_v[k];
+		last_v[k] = v_now;
+	}
+}
+
+void CapacitorBatch::restart_history(std::span<const scalar> probe, scalar probe_timestep, const StampParams &params) {
+	for (size_t k = 0; k < capacitance.size(); ++k) {
+		const scalar slope = (probe[node0[k]] - probe[node1[k]] - last_v[k]) / probe_timestep;
+		last_i[k] = capacitance[k] * slope;
+		prev_v[k] = last_v[k] - params.timestep * slope;
+	}
+}
+
+void CapacitorBatch::set_operating_point(std::span<const scalar> solution) {
+	for (size_t k = 0; k < capacitance.size(); ++k) {
+		last_v[k] = solution[node0[k]] - solution[node1[k]];
+		prev_v[k] = last_v[k];
+		last_i[k] = 0.0;
+	}
+}
+
+void CapacitorBatch::rescale_history(scalar old_timestep, scalar new_timestep) {
+	for (size_t k = 0; k < capacitance.size(); ++k) {
+		const scalar slope = last_i[k] / capacitance[k];
+		const scalar curvature = 2.0 * (old_timestep * slope - (last_v[k] - prev_v[k])) / (old_timestep * old_timestep);
+		prev_v[k] = last_v[k] - new_timestep * slope + 0.5 * new_timestep * new_timestep * curvature;
+	}
+}
+
+scalar CapacitorBatch::error_ratio(std::span<const scalar> solution, const StampParams &params, scalar reltol) const {
+	const IntegrationCoefficients &c = params.integration;
+	scalar ratio = 0.0;
+
+	for (size_t k = 0; k < capacitance.size(); ++k) {
+		const scalar v_now = solution[node0[k]] - solution[node1[k]];
+		const scalar slope = last_i[k] / capacitance[k];
+		const scalar predicted = c.order == 1 ? last_v[k] + params.timestep * slope : prev_v[k] + 2.0 * params.timestep * slope;
+
+		const scalar error = c.error_constant * std::abs(v_now - predicted);
+		const scalar tolerance = reltol * std::max(std::abs(v_now), std::abs(last_v[k])) + voltage_abstol;
+		ratio = std::max(ratio, error / tolerance);
+	}
+
+	return ratio;
+}
+
+
+// Inductors
+
+size_t InductorBatch::add(size_t node0, size_t node1, size_t branch, scalar inductance) {
+	this->node0.push_back(node0);
+	this->node1.push_back(node1);
+	this->branch.push_back(branch);
+	this->inductance.push_back(inductance);
+	last_i.push_back(0.0);
+	prev_i.push_back(0.0);
+	last_v.push_back(0.0);
+	return this->inductance.size() - 1;
+}
+
+void InductorBatch::reserve_matrix_entries(StampPattern &pattern) {
+	slots.resize(inductance.size());
+
+	for (size_t k = 0; k < slots.size(); ++k) {
+		slots[k] = {
+			pattern.reserve(branch[k], branch[k]),
+			pattern.reserve(node0[k], branch[k]),
+			pattern.reserve(branch[k], node0[k]),
+			pattern.reserve(node1[k], branch[k]),
+			pattern.reserve(branch[k], node1[k])
+		};
+	}
+}
+
+void InductorBatch::stamp_matrix(std::vector<scalar> &entries, const StampParams &params) const {
+	for (size_t k = 0; k < slots.size(); ++k) {
+		entries[slots[k][0]] = -params.integration.a0 * inductance[k] * params.timestep_inv;
+		entries[slots[k][1]] = 1.0;
+		entries[slots[k][2]] = 1.0;
+		entries[slots[k][3]] = -1.0;
+		entries[slots[k][4]] = -1.0;
+	}
+}
+
+// v - a0 L/dt i = L/dt (a1 i_{n-1} + a2 i_{n-2}) - b1 v_{n-1}
+void InductorBatch::stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const {
+	const IntegrationCoefficients &c = params.integration;
+
+	for (size_t k = 0; k < inductance.size(); ++k) {
+		rhs[branch[k]] += inductance[k] * params.timestep_inv * (c.a1 * last_i[k] + c.a2 * prev_i[k]) - c.b1 * last_v[k];
+	}
+}
+
+void InductorBatch::update(std::span<const scalar> solution, const StampParams &params) {
+	for (size_t k = 0; k < inductance.size(); ++k) {
+		prev_i[k] = last_i[k];
+		last_i[k] = solution[branch[k]];
+		last_v[k] = solution[node0[k]] - solution[node1[k]];
+	}
+}
+
+void InductorBatch::restart_history(std::span<const scalar> probe, scalar probe_timestep, const StampParams &params) {
+	for (size_t k = 0; k < inductance.size(); ++k) {
+		const scalar slope = (probe[branch[k]] - last_i[k]) / probe_timestep;
+		last_v[k] = inductance[k] * slope;
+		prev_i[k] = last_i[k] - params.timestep * slope;
+	}
+}
+
+void InductorBatch::set_operating_point(std::span<const scalar> solution) {
+	for (size_t k = 0; k < inductance.size(); ++k) {
+		last_i[k] = solution[branch[k]];
+		prev_i[k] = last_i[k];
+		last_v[k] = 0.0;
+	}
+}
+
+void InductorBatch::rescale_history(scalar old_timestep, scalar new_timestep) {
+	for (size_t k = 0; k < inductance.size(); ++k) {
+		const scalar slope = last_v[k] / inductance[k];
+		const scalar curvature = 2.0 * (old_timestep * slope - (last_i[k] - prev_i[k])) / (old_timestep * old_timestep);
+		prev_i[k] = last_i[k] - new_timestep * slope + 0.5 * new_timestep * new_timestep * curvature;
+	}
+}
+
+scalar InductorBatch::error_ratio(std::span<const scalar> solution, const StampParams &params, scalar reltol) const {
+	const IntegrationCoefficients &c = params.integration;
+	scalar ratio = 0.0;
+
+	for (size_t k = 0; k < inductance.size(); ++k) {
+		const scalar i_now = solution[branch[k]];
+		const scalar slope = last_v[k] / inductance[k];
+		const scalar predicted = c.order == 1 ? last_i[k] + params.timestep * slope : prev_i[k] + 2.0 * params.timestep * slope;
+
+		const scalar error = c.error_constant * std::abs(i_now - predicted);
+		const scalar tolerance = reltol * std::max(std::abs(i_now), std::abs(last_i[k])) + current_abstol;
+		ratio = std::max(ratio, error / tolerance);
+	}
+
+	return ratio;
+}
+
+
+// Switches
+
+size_t SwitchBatch::add(size_t node0, size_t node1, size_t branch, bool on) {
+	this->node0.push_back(node0);
+	this->node1.push_back(node1);
+	this->branch.push_back(branch);
+	this->on.push_back(on);
+	stamped_on.push_back(on);
+	solved_on.push_back(on);
+	last_i.push_back(0.0);
+
+	changed = true;
+
+	return this->branch.size() - 1;
+}
+
+void SwitchBatch::reserve_matrix_entries(StampPattern &pattern) {
+	slots.resize(branch.size());
+
+	for (size_t k = 0; k < slots.size(); ++k) {
+		slots[k] = {
+			pattern.reserve(branch[k], branch[k]),
+			pattern.reserve(node0[k], branch[k]),
+			pattern.reserve(branch[k], node0[k]),
+			pattern.reserve(node1[k], branch[k]),
+			pattern.reserve(branch[k], node1[k])
+		};
+	}
+}
+
+void SwitchBatch::stamp_matrix(std::vector<scalar> &entries, const StampParams &params) {
+	for (size_t k = 0; k < slots.size(); ++k) {
+		entries[slots[k][0]] = on[k] ? 0.0 : -off_resistance;
+		entries[slots[k][1]] = 1.0;
+		entries[slots[k][2]] = 1.0;
+		entries[slots[k][3]] = -1.0;
+		entries[slots[k][4]] = -1.0;
+	}
+
+	mark_stamped();
+}
+
+void SwitchBatch::update(std::span<const scalar> solution, const StampParams &params) {
+	const size_t n = branch.size();
+
+	for (size_t k = 0; k < n; ++k) {
+		last_i[k] = solution[branch[k]];
+	}
+}
+
+void SwitchBatch::apply(const Event &event) {
+	on[event.target] = event.kind == EventKind::switch_on;
+}
+
+
+void SwitchBatch::diagonal_changes(std::vector<std::pair<size_t, scalar>> &changes) const {
+	for (size_t k = 0; k < branch.size(); ++k) {
+		if (on[k] == stamped_on[k]) continue;
+
+		// the diagonal entry is -off_resistance when off and 0 when on
+		changes.push_back({ branch[k], on[k] ? off_resistance : -off_resistance });
+	}
+}
+
+void SwitchBatch::mark_stamped() {
+	stamped_on = on;
+	solved_on = on;
+	changed = false;
+}
+
+
+// Voltage sources
+
+size_t VoltageSourceBatch::add(size_t node0, size_t node1, size_t branch, scalar voltage) {
+	this->node0.push_back(node0);
+	this->node1.push_back(node1);
+	this->branch.push_back(branch);
+	this->voltage.push_back(voltage);
+	current.push_back(0.0);
+	return this->voltage.size() - 1;
+}
+
+void VoltageSourceBatch::reserve_matrix_entries(StampPattern &pattern) {
+	slots.resize(voltage.size());
+
+	for (size_t k = 0; k < slots.size(); ++k) {
+		slots[k] = {
+			pattern.reserve(node0[k], branch[k]),
+			pattern.reserve(branch[k], node0[k]),
+			pattern.reserve(node1[k], branch[k]),
+			pattern.reserve(branch[k], node1[k])
+		};
+	}
+}
+
+void VoltageSourceBatch::stamp_matrix(std::vector<scalar> &entries, const StampParams &params) const {
+	for (size_t k = 0; k < slots.size(); ++k) {
+		entries[slots[k][0]] = 1.0;
+		entries[slots[k][1]] = 1.0;
+		entries[slots[k][2]] = -1.0;
+		entries[slots[k][3]] = -1.0;
+	}
+}
+
+void VoltageSourceBatch::stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const {
+	for (size_t k = 0; k < voltage.size(); ++k) {
+		rhs[branch[k]] += voltage[k];
+	}
+}
+
+void VoltageSourceBatch::update(std::span<const scalar> solution, const StampParams &params) {
+	for (size_t k = 0; k < voltage.size(); ++k) {
+		current[k] = solution[branch[k]];
+	}
+}
+
+
+// Current sources
+
+size_t CurrentSourceBatch::add(size_t node0, size_t node1, scalar current) {
+	this->node0.push_back(node0);
+	this->node1.push_back(node1);
+	this->current.push_back(current);
+	return this->current.size() - 1;
+}
+
+void CurrentSourceBatch::stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const {
+	for (size_t k = 0; k < current.size(); ++k) {
+		rhs[node0[k]] -= current[k];
+		rhs[node1[k]] += current[k];
+	}
+}
+
+
+// Engine
+
+void Engine::reset(size_t num_rows) {
+	resistors = {};
+	capacitors = {};
+	inductors = {};
+	switches = {};
+	voltage_sources = {};
+	current_sources = {};
+	events.clear();
+
+	this->num_rows = num_rows;
+	solution.assign(num_rows + 1, 0.0);
+	stamp_values.clear();
+}
+
+void Engine::reserve_matrix_entries(StampPattern &pattern) {
+	resistors.reserve_matrix_entries(pattern);
+	capacitors.reserve_matrix_entries(pattern);
+	inductors.reserve_matrix_entries(pattern);
+	switches.reserve_matrix_entries(pattern);
+	voltage_sources.reserve_matrix_entries(pattern);
+
+	stamp_values.assign(pattern.num_slots(), 0.0);
+}
+
+void Engine::stamp_matrix(const StampParams &params) {
+	resistors.stamp_matrix(stamp_values, params);
+	capacitors.stamp_matrix(stamp_values, params);
+	inductors.stamp_matrix(stamp_values, params);
+	switches.stamp_matrix(stamp_values, params);
+	voltage_sources.stamp_matrix(stamp_values, params);
+}
+
+void Engine::collect_stamp_changes(std::vector<std::pair<size_t, scalar>> &changes) {
+	changes.clear();
+	switches.diagonal_changes(changes);
+	switches.solved_on = switches.on;
+	switches.changed = false;
+}
+
+void Engine::get_switch_state(std::vector<bool> &state) const {
+	state.assign(switches.on.begin(), switches.on.end());
+}
+
+void Engine::mark_stamped() {
+	switches.mark_stamped();
+}
+
+void Engine::stamp_rhs(const StampParams &params) {
+	std::fill(solution.begin(), solution.end(), 0.0);
+
+	capacitors.stamp_rhs(solution, params);
+	inductors.stamp_rhs(solution, params);
+	voltage_sources.stamp_rhs(solution, params);
+	current_sources.stamp_rhs(solution, params);
+
+	// drop the stamps into the ground row
+	solution[num_rows] = 0.0;
+}
+
+void Engine::restart_history(const StampParams &probe_params, const StampParams &params) {
+	capacitors.restart_history(solution, probe_params.timestep, params);
+	inductors.restart_history(solution, probe_params.timestep, params);
+}
+
+void Engine::set_operating_point(const StampParams &params) {
+	capacitors.set_operating_point(solution);
+	inductors.set_operating_point(solution);
+	switches.update(solution, params);
+	voltage_sources.update(solution, params);
+}
+
+void Engine::rescale_history(scalar old_timestep, scalar new_timestep) {
+	capacitors.rescale_history(old_timestep, new_timestep);
+	inductors.rescale_history(old_timestep, new_timestep);
+}
+
+scalar Engine::error_ratio(const StampParams &params, scalar reltol) const {
+	return std::max(
+		capacitors.error_ratio(solution, params, reltol),
+		inductors.error_ratio(solution, params, reltol)
+	);
+}
+
+void Engine::update(const StampParams &params) {
+	capacitors.update(solution, params);
+	inductors.update(solution, params);
+	switches.update(solution, params);
+	voltage_sources.update(solution, params);
+}
+
+void Engine::apply_events(scalar time) {
+	const std::span<const Event> due = events.pop_before(time);
+	if (due.empty()) return;
+
+	for (const Event &event : due) {
+		switch (event.kind) {
+			case EventKind::switch_on:
+			case EventKind::switch_off:
+				switches.apply(event);
+				break;
+		}
+	}
+
+	// a switch toggled there and back again changes nothing, one toggled back to the factorized state
+	// after a low rank update drops the update
+	if (switches.on != switches.solved_on) switches.changed = true;
+}
+
+void Engine::set_parameter(const Parameter &parameter, scalar value) noexcept {
+	const size_t k = parameter.batch_id;
+
+	switch (parameter.kind) {
+		case ParameterKind::resistance: resistors.conductance[k] = 1.0 / value; break;
+		case ParameterKind::capacitance: capacitors.capacitance[k] = value; break;
+		case ParameterKind::inductance: inductors.inductance[k] = value; break;
+		case ParameterKind::voltage: voltage_sources.voltage[k] = value; break;
+		case ParameterKind::current: current_sources.current[k] = value; break;
+	}
+}
+
+scalar Engine::get_parameter(const Parameter &parameter) const noexcept {
+	const size_t k = parameter.batch_id;
+
+	switch (parameter.kind) {
+		case ParameterKind::resistance: return 1.0 / resistors.conductance[k];
+		case ParameterKind::capacitance: return capacitors.capacitance[k];
+		case ParameterKind::inductance: return inductors.inductance[k];
+		case ParameterKind::voltage: return voltage_sources.voltage[k];
+		case ParameterKind::current: return current_sources.current[k];
+	}
+	return 0.0;
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "event_queue.h"
+#include "parameter.h"
+#include "scalar.h"
+#include "stamp_pattern.h"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+
+// how the reactive parts discretize their derivative
+enum class IntegrationMethod {
+	backward_euler,
+	trapezoidal,
+	bdf2
+};
+
+/* The derivative of x at step n is approximated as
+ *     x'_n = (a0 x_n + a1 x_{n-1} + a2 x_{n-2}) / dt - b1 x'_{n-1}
+ * backward euler is first order, trapezoidal and BDF2 (Gear 2) are second order. The
+ * trapezoidal rule keeps the oscillations undamped, BDF2 damps them slightly but stays stable on switching.
+ *
+ * The local truncation error is estimated as error_constant * |x_n - predicted x_n|, the predictor
+ * is x_{n-1} + dt x'_{n-1} for the first order and x_{n-2} + 2 dt x'_{n-1} for the second order. The predictors
+ * are off by dt^2 x''/2 and dt^3 x'''/3, the methods by C dt^2 x'' and C dt^3 x''' with C = 1/2 for backward
+ * euler, 1/12 for trapezoidal and 2/9 for BDF2, so the error constant is C / (C + the predictor's C). */
+struct IntegrationCoefficients {
+	scalar a0, a1, a2, b1;
+	int order;
+	scalar error_constant;
+};
+
+constexpr IntegrationCoefficients integration_coefficients(IntegrationMethod method) noexcept {
+	switch (method) {
+		case IntegrationMethod::trapezoidal: return { 2.0, -2.0, 0.0, 1.0, 2, 1.0 / 5.0 };
+		case IntegrationMethod::bdf2: return { 1.5, -2.0, 0.5, 0.0, 2, 2.0 / 5.0 };
+		default: return { 1.0, -1.0, 0.0, 0.0, 1, 1.0 / 2.0 };
+	}
+}
+
+// absolute parts of the error tolerances
+constexpr scalar voltage_abstol = 1e-6;
+constexpr scalar current_abstol = 1e-9;
+
+struct StampParams {
+	scalar timestep;
+	scalar timestep_inv;
+	size_t step;
+	IntegrationCoefficients integration = integration_coefficients(IntegrationMethod::backward_euler);
+};
+
+// backward euler step of dt / a0, it has the same matrix as a step of the method
+constexpr StampParams restart_probe_params(const StampParams &params) noexcept {
+	StampParams probe = params;
+	probe.timestep = params.timestep / params.integration.a0;
+	probe.timestep_inv = params.timestep_inv * params.integration.a0;
+	probe.integration = integration_coefficients(IntegrationMethod::backward_euler);
+	return probe;
+}
+
+
+/* The batches keep all the parts of one type in structure of arrays, so every stamp and
+ * update is a single loop over plain arrays without virtual calls. The node and branch
+ * ids are rows of the solution, the ground row is always zero and stamps into it are discarded. */
+
+struct ResistorBatch {
+	std::vector<size_t> node0, node1;
+	std::vector<scalar> conductance;
+
+	std::vector<std::array<StampSlot, 4>> slots;
+
+	size_t add(size_t node0, size_t node1, scalar conductance);
+	void reserve_matrix_entries(StampPattern &pattern);
+	void stamp_matrix(std::vector<scalar> &entries, const StampParams &params) const;
+};
+
+// companion model: a conductance a0 C/dt in parallel with a current source given by the history,
+// the history starts at rest
+struct CapacitorBatch {
+	std::vector<size_t> node0, node1;
+	std::vector<scalar> capacitance;
+	std::vector<scalar> admittance;
+	std::vector<scalar> last_v;
+	// the voltage one step before last_v
+	std::vector<scalar> prev_v;
+	std::vector<scalar> last_i;
+
+	std::vector<std::array<StampSlot, 4>> slots;
+
+	size_t add(size_t node0, size_t node1, scalar capacitance);
+	void reserve_matrix_entries(StampPattern &pattern);
+	void stamp_matrix(std::vector<scalar> &entries, const StampParams &params);
+	void stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const;
+	void update(std::span<const scalar> solution, const StampParams &params);
+	// replaces the history before the last step by the slope towards the probe solution
+	void restart_history(std::span<const scalar> probe, scalar probe_timestep, const StampParams &params);
+	// the solution is a DC operating point, the history becomes the constant voltage without current
+	void set_operating_point(std::span<const scalar> solution);
+	// moves prev_v to new_timestep before last_v along the quadratic through the history
+	void rescale_history(scalar old_timestep, scalar new_timestep);
+	// largest ratio of the estimated local truncation error to the tolerance
+	scalar error_ratio(std::span<const scalar> solution, const StampParams &params, scalar reltol) const;
+};
+
+// companion model with the current as the branch variable, the history starts at rest
+struct InductorBatch {
+	std::vector<size_t> node0, node1, branch;
+	std::vector<scalar> inductance;
+	std::vector<scalar> last_i;
+	// the current one step before last_i
+	std::vector<scalar> prev_i;
+	std::vector<scalar> last_v;
+
+	std::vector<std::array<StampSlot, 5>> slots;
+
+	size_t add(size_t node0, size_t node1, size_t branch, scalar inductance);
+	void reserve_matrix_entries(StampPattern &pattern);
+	void stamp_matrix(std::vector<scalar> &entries, const StampParams &params) const;
+	void stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const;
+	void update(std::span<const scalar> solution, const StampParams &params);
+	void restart_history(std::span<const scalar> probe, scalar probe_timestep, const StampParams &params);
+	// the history becomes the constant current without voltage
+	void set_operating_point(std::span<const scalar> solution);
+	void rescale_history(scalar old_timestep, scalar new_timestep);
+	scalar error_ratio(std::span<const scalar> solution, const StampParams &params, scalar reltol) const;
+};
+
+// ideal switch when on, off_resistance when off
+struct SwitchBatch {
+	static constexpr scalar off_resistance = 10_M;
+
+	std::vector<size_t> node0, node1, branch;
+	std::vector<uint8_t> on;
+	// the state in the matrix the solver uses, written by stamp_matrix or mark_stamped
+	std::vector<uint8_t> stamped_on;
+	// the state the solver solves with, stamped_on with the diagonal changes of collect_stamp_changes
+	std::vector<uint8_t> solved_on;
+	std::vector<scalar> last_i;
+
+	std::vector<std::array<StampSlot, 5>> slots;
+
+	// the switches differ from solved_on
+	bool changed = false;
+
+	size_t add(size_t node0, size_t node1, size_t branch, bool on);
+	void reserve_matrix_entries(StampPattern &pattern);
+	void stamp_matrix(std::vector<scalar> &entries, const StampParams &params);
+	void update(std::span<const scalar> solution, const StampParams &params);
+	// the switch k is in the state after the event, applying it does not mark the change
+	void apply(const Event &event);
+
+	// (branch row, value added to its diagonal entry) of every switch not in its stamped state
+	void diagonal_changes(std::vector<std::pair<size_t, scalar>> &changes) const;
+	// the solver now uses a matrix with the current state
+	void mark_stamped();
+};
+
+// the single pin sources are connected between their node and the ground row
+struct VoltageSourceBatch {
+	std::vector<size_t> node0, node1, branch;
+	std::vector<scalar> voltage;
+	std::vector<scalar> current;
+
+	std::vector<std::array<StampSlot, 4>> slots;
+
+	size_t add(size_t node0, size_t node1, size_t branch, scalar voltage);
+	void reserve_matrix_entries(StampPattern &pattern);
+	void stamp_matrix(std::vector<scalar> &entries, const StampParams &params) const;
+	void stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const;
+	void update(std::span<const scalar> solution, const StampParams &params);
+};
+
+struct CurrentSourceBatch {
+	std::vector<size_t> node0, node1;
+	std::vector<scalar> current;
+
+	size_t add(size_t node0, size_t node1, scalar current);
+	void stamp_rhs(std::vector<scalar> &rhs, const StampParams &params) const;
+};
+
+
+// Runtime state of a compiled circuit
+class Engine {
+public:
+	ResistorBatch resistors;
+	CapacitorBatch capacitors;
+	InductorBatch inductors;
+	SwitchBatch switches;
+	VoltageSourceBatch voltage_sources;
+	CurrentSourceBatch current_sources;
+
+	// the parts schedule their events while compiling
+	EventQueue events;
+
+private:
+	size_t num_rows = 0;
+
+	// num_rows + 1 values, the last one is the ground row.
+	// Holds the RHS while stamping and the solution after the solve.
+	std::vector<scalar> solution;
+
+	// values the parts write to their stamp slots
+	std::vector<scalar> stamp_values;
+
+public:
+	// removes all parts and sizes the solution for the given number of rows
+	void reset(size_t num_rows);
+
+	inline size_t get_num_rows() const noexcept { return num_rows; }
+	inline size_t get_ground_row() const noexcept { return num_rows; }
+
+	// reserves the matrix entries of all parts, call after all parts were added
+	void reserve_matrix_entries(StampPattern &pattern);
+
+	// true if the matrix entries changed since the last stamp_matrix or collect_stamp_changes
+	inline bool stamp_changed() const noexcept { return switches.changed; }
+
+	// The matrix now differs from the last stamp_matrix only on the diagonal,
+	// lists the differences as (row, value added to the diagonal entry).
+	void collect_stamp_changes(std::vector<std::pair<size_t, scalar>> &changes);
+
+	// the state of every switch, the matrix depends on nothing else that changes while running
+	void get_switch_state(std::vector<bool> &state) const;
+	// The solver switched to a matrix stamped earlier with the current switch state,
+	// clears the changes.
+	void mark_stamped();
+
+	void stamp_matrix(const StampParams &params);
+	inline const std::vector<scalar> &get_stamp_values() const noexcept { return stamp_values; }
+
+	// writes the RHS to the solution, solve the first num_rows values in place
+	void stamp_rhs(const StampParams &params);
+
+	/* The multistep methods need the derivatives to be smooth over their history, which does not hold
+	 * at the start and when a switch toggles. The restart takes a backward euler step of dt / a0 instead,
+	 * which has the same matrix (see restart_probe_params), solve it like a normal step and call restart_history after the solve.
+	 * The history is then rebuilt from the slope of the probe, the following step uses the method again. */
+	void restart_history(const StampParams &probe_params, const StampParams &params);
+
+	/* A backward euler step of dc_timestep is the DC operating point: the capacitors are open
+	 * up to a conductance of C / dc_timestep, which still keeps the nodes between capacitors defined,
+	 * and the inductors are shorted. Solve it like a normal step and call set_operating_point after the solve,
+	 * the parts then start from the steady state instead of from rest. */
+	static constexpr scalar dc_timestep = 1e9;
+	static constexpr StampParams operating_point_params() noexcept {
+		return StampParams{ .timestep = dc_timestep, .timestep_inv = 1.0 / dc_timestep, .step = 0 };
+	}
+	void set_operating_point(const StampParams &params);
+
+	// the history was taken with old_timestep, the next step is new_timestep
+	void rescale_history(scalar old_timestep, scalar new_timestep);
+	// Largest ratio of the estimated local truncation error of the solved step to the tolerance,
+	// call after the solve and before update. Above 1 the step should be solved again with a smaller timestep.
+	scalar error_ratio(const StampParams &params, scalar reltol) const;
+
+	// call after the solve
+	void update(const StampParams &params);
+	// applies the events scheduled before the time, call after update
+	void apply_events(scalar time);
+
+	// the value of the part in its unit, a matrix value takes effect with the next factorization, see changes_matrix
+	void set_parameter(const Parameter &parameter, scalar value) noexcept;
+	scalar get_parameter(const Parameter &parameter) const noexcept;
+	// the time of the first event not applied yet, infinity if there is none
+	inline scalar next_event_time() const noexcept { return events.next_time(); }
+
+	inline std::span<scalar> get_system_rhs() noexcept { return std::span<scalar>(solution).first(num_rows); }
+	inline std::span<const scalar> get_solution() const noexcept { return solution; }
+	inline scalar get_value(size_t row) const noexcept { return solution[row]; }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "scalar.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+
+// at the same time the events apply in this order, so a switch turned on and off at once ends up off
+enum class EventKind {
+	switch_on,
+	switch_off
+};
+
+// a scheduled change of a part, target is its index in the batch of the kind
+struct Event {
+	scalar time;
+	EventKind kind;
+	size_t target;
+};
+
+/* The breakpoints of the circuit in the order of time. The steppers land on the time of every
+ * event and apply it after the solve of the step ending there, the matrix changes only at those
+ * instants and the steps between them can be long. */
+class EventQueue {
+private:
+	std::vector<Event> events;
+	// the first event not applied yet
+	size_t next = 0;
+
+	static bool before(const Event &a, const Event &b) noexcept {
+		if (a.time != b.time) return a.time < b.time;
+		return a.kind < b.kind;
+	}
+
+public:
+	void clear() noexcept {
+		events.clear();
+		next = 0;
+	}
+
+	// an event before the ones already applied applies with the next ones
+	void schedule(const Event &event) {
+		auto it = std::upper_bound(events.begin() + next, events.end(), event, before);
+		events.insert(it, event);
+	}
+
+	// infinity if there is none left
+	scalar next_time() const noexcept {
+		return next < events.size() ? events[next].time : std::numeric_limits<scalar>::infinity();
+	}
+
+	// the events not applied yet in their order
+	std::span<const Event> pending() const noexcept {
+		return std::span<const Event>(events).subspan(next);
+	}
+
+	// removes the events before the time and returns them in their order
+	std::span<const Event> pop_before(scalar time) noexcept {
+		const size_t first = next;
+		while (next < events.size() && events[next].time < time) ++next;
+		return std::span<const Event>(events).subspan(first, next - first);
+	}
+};
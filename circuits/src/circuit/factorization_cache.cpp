@@ -0,0 +1,59 @@
+#include "factorization_cache.h"
+
+#include "../lingebra/lingebra.h"
+#include "scalar.h"
+
+
+void FactorizationCache::evict_to(size_t bytes) {
+	while (used_bytes > bytes && !entries.empty()) {
+		const Entry &last = entries.back();
+		used_bytes -= last.bytes;
+		index.erase(last.key);
+		entries.pop_back();
+		++evictions;
+	}
+}
+
+void FactorizationCache::set_budget(size_t bytes) {
+	budget_bytes = bytes;
+	evict_to(budget_bytes);
+}
+
+void FactorizationCache::clear() noexcept {
+	entries.clear();
+	index.clear();
+	used_bytes = 0;
+}
+
+const lingebra::SparseLU<scalar> *FactorizationCache::find(const Key &key) {
+	auto it = index.find(key);
+
+	if (it == index.end()) {
+		++misses;
+		return nullptr;
+	}
+
+	++hits;
+	entries.splice(entries.begin(), entries, it->second);
+	return &it->second->lu;
+}
+
+bool FactorizationCache::insert(const Key &key, const lingebra::SparseLU<scalar> &lu) {
+	const size_t bytes = lu.memory_bytes() + key.size() / 8 + sizeof(Entry);
+	if (bytes > budget_bytes) return false;
+
+	// replace an existing entry of the same key
+	if (auto it = index.find(key); it != index.end()) {
+		used_bytes -= it->second->bytes;
+		entries.erase(it->second);
+		index.erase(it);
+	}
+
+	evict_to(budget_bytes - bytes);
+
+	entries.push_front(Entry{ .key = key, .lu = lu, .bytes = bytes });
+	index.emplace(key, entries.begin());
+	used_bytes += bytes;
+
+	return true;
+}
\ No newline at end of file
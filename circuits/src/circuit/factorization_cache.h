@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../lingebra/lingebra.h"
+#include "scalar.h"
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+
+// Factorizations of the circuit matrix for the switch states seen so far, evicts the least
+// recently used ones once their memory exceeds the budget. A budget of zero disables the cache.
+class FactorizationCache {
+public:
+	// the state of every switch in the order of the engine
+	using Key = std::vector<bool>;
+
+	static constexpr size_t default_budget_bytes = 16 * 1024 * 1024;
+
+private:
+	struct Entry {
+		Key key;
+		lingebra::SparseLU<scalar> lu;
+		size_t bytes;
+	};
+
+	// most recently used first
+	std::list<Entry> entries;
+	std::unordered_map<Key, std::list<Entry>::iterator> index;
+
+	size_t budget_bytes;
+	size_t used_bytes = 0;
+
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+
+	void evict_to(size_t bytes);
+
+public:
+	explicit FactorizationCache(size_t budget_bytes = default_budget_bytes) : budget_bytes(budget_bytes) {}
+
+	// evicts the entries over the new budget, invalidates the pointers returned by find
+	void set_budget(size_t bytes);
+	inline size_t get_budget() const noexcept { return budget_bytes; }
+	inline bool is_enabled() const noexcept { return budget_bytes != 0; }
+
+	// removes all the entries, the counters are kept. Invalidates the pointers returned by find.
+	void clear() noexcept;
+
+	// Returns the factorization for the key and marks it as the most recently used,
+	// nullptr if there is none. Counts a hit or a miss. The pointer is valid until the next insert, set_budget or clear.
+	const lingebra::SparseLU<scalar> *find(const Key &key);
+
+	// does not count as a hit or a miss and does not change the order
+	inline bool contains(const Key &key) const { return index.contains(key); }
+
+	// Stores a copy of the factorization, evicting the least recently used ones to fit.
+	// Returns false if the factorization alone exceeds the budget.
+	bool insert(const Key &key, const lingebra::SparseLU<scalar> &lu);
+
+	inline size_t size() const noexcept { return entries.size(); }
+	inline size_t get_used_bytes() const noexcept { return used_bytes; }
+
+	inline size_t get_hits() const noexcept { return hits; }
+	inline size_t get_misses() const noexcept { return misses; }
+	inline size_t get_evictions() const noexcept { return evictions; }
+};
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "parts/switch.h"
 #include "parts/voltage_source.h"
 #include "util.h"
+#include <charconv>
 #include <iostream>
 #include <sstream>
 
@@ -172,42 +173,32 @@ void Interpreter::execute_line(std::string_view line, size_t line_idx) {
 			add_basic_part<VoltageSource2Pin, true>(tokens, i, "voltage_source_2P", "V", line_idx);
 		}
 		else if (token == "scope") {
-			if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected token 'current' or 'voltage' after 'scope', got ''", line_idx));
+			const Probe probe = parse_probe(tokens, i, "scope", line_idx);
 
-			auto scope_quantity = tokens[i];
-
-			bool is_current_scope = scope_quantity == "current";
-			bool is_voltage_scope = scope_quantity == "voltage";
-
-			if (is_current_scope || is_voltage_scope) {
-				if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected token 'of' or 'between' after 'scope {}', got ''", line_idx, scope_quantity));
-
-				auto scope_type = tokens[i];
+			if (probe.is_current) circuit.scope_current(probe.a, probe.b);
+			else circuit.scope_voltage(probe.a, probe.b);
+		}
+		else if (token == "output") {
+			const Probe probe = parse_probe(tokens, i, "output", line_idx);
+			const scalar gain = parse_gain(tokens, i, line_idx);
 
-				if (scope_type != "of" && scope_type != "between") throw ParseError(std::format("Syntax error on line {}: Expected token 'of' or 'between' after 'scope {}', got '{}'", line_idx, scope_quantity, scope_type));
+			if (probe.is_current) circuit.output_current(probe.a, probe.b, gain);
+			else circuit.output_voltage(probe.a, probe.b, gain);
+		}
+		else if (token == "input") {
+			if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected a voltage source name after 'input', got ''", line_idx));
 
-				if (scope_type == "of") {
-					if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected part name after 'scope {} of', got ''", line_idx, scope_quantity));
-					auto part = parse_part(std::string(tokens[i]), line_idx);
-					if (part->pin_count() != 2) throw ParseError(std::format("Syntax error on line {}: Expected a 2-pin part after 'scope {} of', got '{}'", line_idx, scope_quantity, tokens[i]));
+			std::string source_name(tokens[i]);
+			Part *part = parse_part(source_name, line_idx);
 
-					if (is_current_scope) circuit.scope_current(part->pin(0), part->pin(1));
-					else circuit.scope_voltage(part->pin(0), part->pin(1));
-				}
-				else if (scope_type == "between") {
-					if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected pin name after 'scope {} between', got ''", line_idx, scope_quantity));
-					auto pin_0 = parse_pin(std::string(tokens[i]), line_idx);
-					std::string_view names_and_keyword = "";
-					if (++i >= tokens.size() || (names_and_keyword = tokens[i]) != "and") throw ParseError(std::format("Syntax error on line {}: Expected 'and' after 'scope {} between {}', got '{}'", line_idx, scope_quantity, pin_0.name, names_and_keyword));
-					if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected pin name after 'scope {} between {} and', got ''", line_idx, scope_quantity, pin_0.name, names_and_keyword));
-					auto pin_1 = parse_pin(std::string(tokens[i]), line_idx);
-
-					if (is_current_scope) circuit.scope_current(pin_0, pin_1);
-					else circuit.scope_voltage(pin_0, pin_1);
-				}
+			if (auto source = dynamic_cast<VoltageSource *>(part)) {
+				circuit.add_input(source, parse_gain(tokens, i, line_idx));
+			}
+			else if (auto source_2pin = dynamic_cast<VoltageSource2Pin *>(part)) {
+				circuit.add_input(source_2pin, parse_gain(tokens, i, line_idx));
 			}
 			else {
-				throw ParseError(std::format("Syntax error on line {}: Expected token 'current' or 'voltage' after 'scope', got '{}'", line_idx, scope_quantity));
+				throw ParseError(std::format("Type error on line {}: {} is not a voltage source", line_idx, source_name));
 			}
 		}
 		else if (token == "turn") {
@@ -232,16 +223,58 @@ void Interpreter::execute_line(std::string_view line, size_t line_idx) {
 				scalar t = parse_value(tokens[i], "s", line_idx);
 
 				if (is_on) {
-					switch_part->schedule_on(t / circuit.get_timestep());
+					switch_part->schedule_on(t);
 				}
 				else {
-					switch_part->schedule_off(t / circuit.get_timestep());
+					switch_part->schedule_off(t);
 				}
 			}
 			else {
 				throw ParseError(std::format("Syntax error on line {}: Expected token 'on' or 'off' after 'turn', got '{}'", line_idx, turn_to));
 			}
 		}
+		else if (token == "integration") {
+			if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected 'backward_euler', 'trapezoidal' or 'bdf2' after 'integration', got ''", line_idx));
+
+			auto method = tokens[i];
+
+			if (method == "backward_euler") circuit.set_integration_method(IntegrationMethod::backward_euler);
+			else if (method == "trapezoidal") circuit.set_integration_method(IntegrationMethod::trapezoidal);
+			else if (method == "bdf2") circuit.set_integration_method(IntegrationMethod::bdf2);
+			else throw ParseError(std::format("Syntax error on line {}: Expected 'backward_euler', 'trapezoidal' or 'bdf2' after 'integration', got '{}'", line_idx, method));
+		}
+		else if (token == "initial") {
+			if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected 'rest' or 'operating_point' after 'initial', got ''", line_idx));
+
+			auto state = tokens[i];
+
+			if (state == "rest") circuit.set_start_from_operating_point(false);
+			else if (state == "operating_point") circuit.set_start_from_operating_point(true);
+			else throw ParseError(std::format("Syntax error on line {}: Expected 'rest' or 'operating_point' after 'initial', got '{}'", line_idx, state));
+		}
+		else if (token == "adaptive") {
+			std::string_view keyword = "";
+			if (++i >= tokens.size() || (keyword = tokens[i]) != "from") throw ParseError(std::format("Syntax error on line {}: Expected token 'from' after 'adaptive', got '{}'", line_idx, keyword));
+			if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected a time value after 'adaptive from', got ''", line_idx));
+			scalar min_timestep = parse_value(tokens[i], "s", line_idx);
+
+			keyword = "";
+			if (++i >= tokens.size() || (keyword = tokens[i]) != "to") throw ParseError(std::format("Syntax error on line {}: Expected token 'to' after 'adaptive from {}', got '{}'", line_idx, tokens[i - 1], keyword));
+			if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected a time value after 'adaptive from {} to', got ''", line_idx, tokens[i - 2]));
+			scalar max_timestep = parse_value(tokens[i], "s", line_idx);
+
+			scalar tolerance = 1e-3;
+			if (i + 1 < tokens.size()) {
+				if (tokens[++i] != "tolerance") throw ParseError(std::format("Syntax error on line {}: Expected token 'tolerance' or end of line after the adaptive timesteps, got '{}'", line_idx, tokens[i]));
+				if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected a value after 'tolerance', got ''", line_idx));
+				tolerance = parse_value(tokens[i], "", line_idx);
+			}
+
+			if (!(min_timestep > 0.0) || max_timestep < min_timestep || !(tolerance > 0.0)) {
+				throw ParseError(std::format("Value error on line {}: Expected 0 < minimal timestep <= maximal timestep and a positive tolerance.", line_idx));
+			}
+			circuit.set_adaptive_timestep(min_timestep, max_timestep, tolerance);
+		}
 		else {
 
 
@@ -269,6 +302,52 @@ void Interpreter::parse_connections(const std::vector<std::string_view> &tokens,
 	}
 }
 
+Interpreter::Probe Interpreter::parse_probe(const std::vector<std::string_view> &tokens, size_t &i, std::string_view keyword, size_t line_idx) const {
+	if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected token 'current' or 'voltage' after '{}', got ''", line_idx, keyword));
+
+	auto quantity = tokens[i];
+
+	bool is_current = quantity == "current";
+	bool is_voltage = quantity == "voltage";
+
+	if (!is_current && !is_voltage) {
+		throw ParseError(std::format("Syntax error on line {}: Expected token 'current' or 'voltage' after '{}', got '{}'", line_idx, keyword, quantity));
+	}
+
+	if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected token 'of' or 'between' after '{} {}', got ''", line_idx, keyword, quantity));
+
+	auto probe_type = tokens[i];
+
+	if (probe_type == "of") {
+		if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected part name after '{} {} of', got ''", line_idx, keyword, quantity));
+		auto part = parse_part(std::string(tokens[i]), line_idx);
+		if (part->pin_count() != 2) throw ParseError(std::format("Syntax error on line {}: Expected a 2-pin part after '{} {} of', got '{}'", line_idx, keyword, quantity, tokens[i]));
+
+		return Probe{ is_current, part->pin(0), part->pin(1) };
+	}
+	else if (probe_type == "between") {
+		if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected pin name after '{} {} between', got ''", line_idx, keyword, quantity));
+		auto pin_0 = parse_pin(std::string(tokens[i]), line_idx);
+		std::string_view names_and_keyword = "";
+		if (++i >= tokens.size() || (names_and_keyword = tokens[i]) != "and") throw ParseError(std::format("Syntax error on line {}: Expected 'and' after '{} {} between {}', got '{}'", line_idx, keyword, quantity, pin_0.name, names_and_keyword));
+		if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected pin name after '{} {} between {} and', got ''", line_idx, keyword, quantity, pin_0.name));
+		auto pin_1 = parse_pin(std::string(tokens[i]), line_idx);
+
+		return Probe{ is_current, pin_0, pin_1 };
+	}
+
+	throw ParseError(std::format("Syntax error on line {}: Expected token 'of' or 'between' after '{} {}', got '{}'", line_idx, keyword, quantity, probe_type));
+}
+
+scalar Interpreter::parse_gain(const std::vector<std::string_view> &tokens, size_t &i, size_t line_idx) const {
+	if (i + 1 >= tokens.size()) return 1.0;
+
+	if (tokens[++i] != "gain") throw ParseError(std::format("Syntax error on line {}: Expected token 'gain' or end of line, got '{}'", line_idx, tokens[i]));
+	if (++i >= tokens.size()) throw ParseError(std::format("Syntax error on line {}: Expected a value after 'gain', got ''", line_idx));
+
+	return parse_value(tokens[i], "", line_idx);
+}
+
 
 void Interpreter::execute(std::istream &in) {
 	std::string line;
@@ -28,6 +28,17 @@ private:
 	Pin parse_pin(const std::string &pinname, size_t line_idx, bool support_twopin = false, size_t twopin_part_pin_id = 0) const;
 	void parse_connections(const std::vector<std::string_view> &tokens, size_t line_idx) const;
 
+	// the quantity between two pins, as in 'scope' and 'output'
+	struct Probe {
+		bool is_current;
+		Pin a;
+		Pin b;
+	};
+	// parses '(voltage|current) of <part>' or '(voltage|current) between <pin> and <pin>' after the keyword
+	Probe parse_probe(const std::vector<std::string_view> &tokens, size_t &i, std::string_view keyword, size_t line_idx) const;
+	// parses an optional 'gain <value>' at the end of the line
+	scalar parse_gain(const std::vector<std::string_view> &tokens, size_t &i, size_t line_idx) const;
+
 	void execute_line(std::string_view line, size_t line_idx);
 
 	template <class T, bool needs_value>
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "engine.h"
 #include "node.h"
 #include "part.h"
 #include <array>
@@ -18,6 +19,14 @@ private:
 protected:
 	std::array<std::string, N> pin_names;
 
+	// the engine the part was compiled into and the index of the part in its batch
+	const Engine *engine = nullptr;
+	size_t batch_id = 0;
+
+	size_t node_id(size_t pin_id) const noexcept { return nodes[pin_id]->node_id; }
+	// 0 before compile
+	scalar voltage(size_t pin_id) const noexcept { return engine ? engine->get_value(node_id(pin_id)) : 0.0; }
+
 	void assert_pin_id(size_t pin_id) const {
 		if (pin_id >= N) {
 			throw std::out_of_range(std::format("NPinPart<{}> does not have pin {}", N, pin_id));
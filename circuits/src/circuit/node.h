@@ -1,10 +1,10 @@
 #pragma once
 
-#include "scalar.h"
+#include <cstddef>
 
 
 struct Node {
-	scalar voltage = 0.0;
+	// row of the node voltage in the system, assigned by Circuit::compile
 	size_t node_id = 0;
 	bool is_ground = false;
 };
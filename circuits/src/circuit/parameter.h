@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "scalar.h"
+#include <cstddef>
+#include <span>
+
+
+// the value of a part that can change while running, in the unit of the part
+enum class ParameterKind {
+	resistance,
+	capacitance,
+	inductance,
+	voltage,
+	current
+};
+
+// the sources only change the RHS, the other values change the matrix and need a factorization
+constexpr bool changes_matrix(ParameterKind kind) noexcept {
+	return kind == ParameterKind::resistance || kind == ParameterKind::capacitance || kind == ParameterKind::inductance;
+}
+
+// handle of a part value, batch_id is the index of the part in the batch of its kind
+struct Parameter {
+	ParameterKind kind;
+	size_t batch_id;
+};
+
+// the value ramps linearly to the new one over smoothing_time seconds, 0 sets it at once
+struct ParameterChange {
+	Parameter parameter;
+	scalar value;
+	scalar smoothing_time = 0.0;
+};
+
+
+/* Parameter changes from one control thread to the simulation thread, which applies them
+ * at the block boundaries. Lock-free and allocation free on both sides. */
+class ParameterQueue {
+public:
+	static constexpr size_t default_capacity = 256;
+
+private:
+	RingBuffer<ParameterChange> changes;
+
+public:
+	explicit ParameterQueue(size_t capacity = default_capacity) : changes(capacity) {}
+
+	// the control thread, false if the queue is full and the change was dropped
+	inline bool post(const ParameterChange &change) noexcept {
+		return changes.push(std::span<const ParameterChange>(&change, 1)) == 1;
+	}
+
+	// the simulation thread, returns the count of the changes taken in the order they were posted
+	inline size_t take(std::span<ParameterChange> out) noexcept {
+		return changes.pop(out);
+	}
+};
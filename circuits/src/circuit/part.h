@@ -1,21 +1,15 @@
 #pragma once
 
+#include <optional>
 #include <string>
-#include <tuple>
-#include <vector>
 
 #include "node.h"
+#include "parameter.h"
 #include "pin.h"
 #include "scalar.h"
 
 
-struct StampParams {
-	const ConstPin &ground;
-	scalar timestep;
-	scalar timestep_inv;
-	size_t step;
-};
-
+class Engine;
 
 class Part {
 public:
@@ -35,16 +29,16 @@ public:
 	virtual void set_first_matrix_row_id(size_t first_row_id) {}
 	virtual size_t get_first_matrix_row_id() { return 0; };
 
-	virtual std::vector<std::tuple<size_t, size_t, scalar>> gen_matrix_entries(const StampParams &params) = 0;
-	virtual void stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) = 0;
+	// Called by Circuit::compile once the matrix rows are assigned. The part adds itself to the
+	// batch of its type in the engine, which then stamps and updates it without virtual calls.
+	// The part reads its state from the engine until the next compile.
+	virtual void compile(Engine &engine) = 0;
 
 	virtual const std::string &get_name() const = 0;
 	virtual void set_name(const std::string &name) = 0;
 
 	virtual scalar get_current_between(const ConstPin &a, const ConstPin &b) const = 0;
 
-	// i in range 0 .. num_needed_matrix_rows() - 1
-	virtual void update_value_from_result(size_t i, scalar value) {}
-
-	virtual void update(const StampParams &params) {};
+	// the value that can change while running, valid after compile, none for the parts without a value
+	virtual std::optional<Parameter> get_parameter() const { return std::nullopt; }
 };
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "../engine.h"
 #include "../n_pin_part.h"
 #include "../part.h"
 #include "../pin.h"
@@ -9,54 +10,16 @@
 
 Capacitor::Capacitor(const std::string &name, scalar capacitance) :
 	NPinPart<2>(name),
-	capacitance(capacitance),
-	last_v(0.0),
-	last_i(0.0),
-	admittance(0.0) {
+	capacitance(capacitance) {
 }
 
 
-std::vector<std::tuple<size_t, size_t, scalar>> Capacitor::gen_matrix_entries(const StampParams &params) {
-	admittance = capacitance * params.timestep_inv;
-
-	const auto &node0 = pin(0).node;
-	const auto &node1 = pin(1).node;
-
-	std::vector<std::tuple<size_t, size_t, scalar>> entries;
-
-	if (!node0->is_ground && !node1->is_ground) {
-		entries.push_back({ node0->node_id, node0->node_id, admittance });
-		entries.push_back({ node0->node_id, node1->node_id, -admittance });
-		entries.push_back({ node1->node_id, node0->node_id, -admittance });
-		entries.push_back({ node1->node_id, node1->node_id, admittance });
-	}
-	else if (!node0->is_ground) {
-		entries.push_back({ node0->node_id, node0->node_id, admittance });
-	}
-	else if (!node1->is_ground) {
-		entries.push_back({ node1->node_id, node1->node_id, admittance });
-	}
-
-	return entries;
-}
-
-void Capacitor::stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) {
-	const auto &node0 = pin(0).node;
-	const auto &node1 = pin(1).node;
-
-	auto value = admittance * last_v;
-
-	if (!node0->is_ground) rhs[node0->node_id] = value;
-	if (!node1->is_ground) rhs[node1->node_id] = -value;
-}
-
-void Capacitor::update(const StampParams &params) {
-	scalar v_now = pin(0).node->voltage - pin(1).node->voltage;
-	last_i = admittance * (v_now - last_v);
-	last_v = v_now;
+void Capacitor::compile(Engine &engine) {
+	this->engine = &engine;
+	batch_id = engine.capacitors.add(node_id(0), node_id(1), capacitance);
 }
 
 
 scalar Capacitor::get_current_between(const ConstPin &a, const ConstPin &b) const {
-	return last_i;
+	return engine ? engine->capacitors.last_i[batch_id] : 0.0;
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "../engine.h"
 #include "../n_pin_part.h"
 #include "../part.h"
 #include "../pin.h"
@@ -11,12 +12,9 @@ CurrentSource::CurrentSource(const std::string &name, scalar current) :
 	current(current) {
 }
 
-void CurrentSource::stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) {
-	const auto &node0 = pin(0).node;
-	const auto &node1 = pin(1).node;
-
-	if (!node0->is_ground) rhs[node0->node_id] = -current;
-	if (!node1->is_ground) rhs[node1->node_id] = current;
+void CurrentSource::compile(Engine &engine) {
+	this->engine = &engine;
+	batch_id = engine.current_sources.add(node_id(0), node_id(1), current);
 }
 
 scalar CurrentSource::get_current_between(const ConstPin &a, const ConstPin &b) const {
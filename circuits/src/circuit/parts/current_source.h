@@ -1,9 +1,12 @@
 #pragma once
 
+#include "../engine.h"
 #include "../n_pin_part.h"
 #include "../part.h"
 #include "../pin.h"
+#include "../parameter.h"
 #include "../scalar.h"
+#include <optional>
 #include <string>
 
 
@@ -15,8 +18,9 @@ public:
 	CurrentSource(const std::string &name, scalar current);
 	~CurrentSource() noexcept = default;
 
-	std::vector<std::tuple<size_t, size_t, scalar>> gen_matrix_entries(const StampParams &params) override { return {}; }
-	void stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) override;
+	void compile(Engine &engine) override;
 
 	scalar get_current_between(const ConstPin &a, const ConstPin &b) const override;
+
+	std::optional<Parameter> get_parameter() const override { return Parameter{ ParameterKind::current, batch_id }; }
 };
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "../engine.h"
 #include "../n_pin_part.h"
 #include "../part.h"
 #include "../pin.h"
@@ -9,37 +10,14 @@
 Inductor::Inductor(const std::string &name, scalar inductance) :
 	NPinPart<2>(name),
 	inductance(inductance),
-	branch_id(0),
-	last_i(0.0) {
+	branch_id(0) {
 }
 
-std::vector<std::tuple<size_t, size_t, scalar>> Inductor::gen_matrix_entries(const StampParams &params) {
-	const scalar req = inductance * params.timestep_inv;
-
-	std::vector<std::tuple<size_t, size_t, scalar>> entries;
-
-	entries.push_back({ branch_id, branch_id, -req });
-
-	const auto &node0 = pin(0).node;
-	const auto &node1 = pin(1).node;
-
-	if (!node0->is_ground) {
-		entries.push_back({ node0->node_id, branch_id, 1.0 });
-		entries.push_back({ branch_id, node0->node_id, 1.0 });
-	}
-	if (!node1->is_ground) {
-		entries.push_back({ node1->node_id, branch_id, -1.0 });
-		entries.push_back({ branch_id, node1->node_id, -1.0 });
-	}
-
-	return entries;
-}
-
-void Inductor::stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) {
-	const scalar req = inductance * params.timestep_inv;
-	rhs[branch_id] += -req * last_i;
+void Inductor::compile(Engine &engine) {
+	this->engine = &engine;
+	batch_id = engine.inductors.add(node_id(0), node_id(1), branch_id, inductance);
 }
 
 scalar Inductor::get_current_between(const ConstPin &a, const ConstPin &b) const {
-	return last_i;
+	return engine ? engine->inductors.last_i[batch_id] : 0.0;
 }
\ No newline at end of file
@@ -5,31 +5,16 @@ Resistor::Resistor(const std::string &name, scalar ohms) : NPinPart<2>(name), oh
 	conductance = 1.0f / ohms;
 }
 
-std::vector<std::tuple<size_t, size_t, scalar>> Resistor::gen_matrix_entries(const StampParams &params) {
-	const auto &node0 = pin(0).node;
-	const auto &node1 = pin(1).node;
-
-	std::vector<std::tuple<size_t, size_t, scalar>> entries;
-
-	if (!node0->is_ground && !node1->is_ground) {
-		entries.push_back({ node0->node_id, node0->node_id, conductance });
-		entries.push_back({ node0->node_id, node1->node_id, -conductance });
-		entries.push_back({ node1->node_id, node0->node_id, -conductance });
-		entries.push_back({ node1->node_id, node1->node_id, conductance });
-	}
-	else if (!node0->is_ground) {
-		entries.push_back({ node0->node_id, node0->node_id, conductance });
-	}
-	else if (!node1->is_ground) {
-		entries.push_back({ node1->node_id, node1->node_id, conductance });
-	}
-
-	return entries;
+void Resistor::compile(Engine &engine) {
+	this->engine = &engine;
+	batch_id = engine.resistors.add(node_id(0), node_id(1), conductance);
 }
 
 scalar Resistor::get_current_between(const ConstPin &a, const ConstPin &b) const {
 	if (a.owner != this || b.owner != this) {
 		throw std::runtime_error("Pins a and b must belong to this part.");
 	}
-	return conductance * (a.node->voltage - b.node->voltage);
+	// the conductance can change while running
+	const scalar g = engine ? engine->resistors.conductance[batch_id] : conductance;
+	return g * (voltage(a.pin_id) - voltage(b.pin_id));
 }
\ No newline at end of file
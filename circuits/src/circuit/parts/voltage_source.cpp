@@ -3,15 +3,17 @@
 
 
 
-VoltageSource::VoltageSource(const std::string &name, scalar voltage) : NPinPart<1>(name), voltage(voltage), branch_id(0), current(0) {}
+VoltageSource::VoltageSource(const std::string &name, scalar voltage) : NPinPart<1>(name), voltage(voltage), branch_id(0) {}
 
 VoltageSource::~VoltageSource() {}
 
-std::vector<std::tuple<size_t, size_t, scalar>> VoltageSource::gen_matrix_entries(const StampParams &params) {
-	const auto &node = pin().node;
-	if (node->is_ground) return {};
+void VoltageSource::compile(Engine &engine) {
+	this->engine = &engine;
 
-	return { {node->node_id, branch_id, 1.0}, {branch_id, node->node_id, 1.0} };
+	// a grounded source has no branch row, all its entries would go to the ground row
+	if (pin().node->is_ground) return;
+
+	batch_id = engine.voltage_sources.add(node_id(0), engine.get_ground_row(), branch_id, voltage);
 }
 
 scalar VoltageSource::get_current_between(const ConstPin &a, const ConstPin &b) const {
@@ -22,52 +24,29 @@ scalar VoltageSource::get_current_between(const ConstPin &a, const ConstPin &b)
 		throw std::runtime_error("Pin b must be a ground pin.");
 	}
 
-	return current;
-}
-
-void VoltageSource::stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) {
-	rhs[branch_id] += voltage;
+	if (!engine || pin().node->is_ground) return 0.0;
+	return engine->voltage_sources.current[batch_id];
 }
 
-void VoltageSource::update_value_from_result(size_t i, scalar value) {
-	current = value;
+std::optional<Parameter> VoltageSource::get_parameter() const {
+	if (pin().node->is_ground) return std::nullopt;
+	return Parameter{ ParameterKind::voltage, batch_id };
 }
 
 
 
-VoltageSource2Pin::VoltageSource2Pin(const std::string &name, scalar voltage) : NPinPart<2>(name), voltage(voltage), branch_id(0), current(0) {}
+VoltageSource2Pin::VoltageSource2Pin(const std::string &name, scalar voltage) : NPinPart<2>(name), voltage(voltage), branch_id(0) {}
 
 VoltageSource2Pin::~VoltageSource2Pin() {}
 
-std::vector<std::tuple<size_t, size_t, scalar>> VoltageSource2Pin::gen_matrix_entries(const StampParams &params) {
-	const auto &node0 = pin(0).node;
-	const auto &node1 = pin(1).node;
-
-	std::vector<std::tuple<size_t, size_t, scalar>> entries;
-
-	if (!node0->is_ground) {
-		entries.push_back({ node0->node_id, branch_id, 1.0 });
-		entries.push_back({ branch_id, node0->node_id, 1.0 });
-	}
-	if (!node1->is_ground) {
-		entries.push_back({ node1->node_id, branch_id, -1.0 });
-		entries.push_back({ branch_id, node1->node_id, -1.0 });
-	}
-
-	return entries;
-}
-
-void VoltageSource2Pin::stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) {
-	rhs[branch_id] += voltage;
+void VoltageSource2Pin::compile(Engine &engine) {
+	this->engine = &engine;
+	batch_id = engine.voltage_sources.add(node_id(0), node_id(1), branch_id, voltage);
 }
 
 scalar VoltageSource2Pin::get_current_between(const ConstPin &a, const ConstPin &b) const {
 	if (a.owner != this || b.owner != this) {
 		throw std::runtime_error("Pins a and b must belong to this part.");
 	}
-	return current;
-}
-
-void VoltageSource2Pin::update_value_from_result(size_t i, scalar value) {
-	current = value;
+	return engine ? engine->voltage_sources.current[batch_id] : 0.0;
 }
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 
 
+#include "../engine.h"
 #include "../n_pin_part.h"
 #include "../part.h"
 #include "../pin.h"
+#include "../parameter.h"
 #include "../scalar.h"
+#include <optional>
 #include <string>
 
 
@@ -13,8 +16,6 @@ private:
 	scalar voltage;
 	size_t branch_id;
 
-	scalar current;
-
 public:
 	explicit VoltageSource(const std::string &name, scalar voltage);
 	~VoltageSource() noexcept;
@@ -23,12 +24,12 @@ public:
 	void set_first_matrix_row_id(size_t row_id) override { branch_id = row_id; }
 	size_t get_first_matrix_row_id() override { return branch_id; }
 
-	std::vector<std::tuple<size_t, size_t, scalar>> gen_matrix_entries(const StampParams &params) override;
-	void stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) override;
+	void compile(Engine &engine) override;
 
 	scalar get_current_between(const ConstPin &a, const ConstPin &b) const override;
 
-	void update_value_from_result(size_t i, scalar value) override;
+	// none for a source connected to the ground, it is not in the batch
+	std::optional<Parameter> get_parameter() const override;
 };
 
 
@@ -37,8 +38,6 @@ private:
 	scalar voltage;
 	size_t branch_id;
 
-	scalar current;
-
 public:
 	explicit VoltageSource2Pin(const std::string &name, scalar voltage);
 	~VoltageSource2Pin() noexcept;
@@ -47,10 +46,9 @@ public:
 	void set_first_matrix_row_id(size_t row_id) override { branch_id = row_id; }
 	size_t get_first_matrix_row_id() override { return branch_id; }
 
-	std::vector<std::tuple<size_t, size_t, scalar>> gen_matrix_entries(const StampParams &params) override;
-	void stamp_rhs_entries(std::vector<scalar> &rhs, const StampParams &params) override;
+	void compile(Engine &engine) override;
 
 	scalar get_current_between(const ConstPin &a, const ConstPin &b) const override;
 
-	void update_value_from_result(size_t i, scalar value) override;
+	std::optional<Parameter> get_parameter() const override { return Parameter{ ParameterKind::voltage, batch_id }; }
 };
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "polyphony.h"
+
+#include "../lingebra/lingebra.h"
+#include "circuit.h"
+#include "decimator.h"
+#include "engine.h"
+#include "parameter.h"
+#include "scalar.h"
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+
+template <size_t Voices>
+Polyphony<Voices>::Polyphony(Circuit &circuit) :
+	timestep(circuit.timestep),
+	oversampling(circuit.oversampling),
+	integration_method(circuit.integration_method),
+	slot_value_ids(circuit.slot_value_ids),
+	initial_decimator(circuit.oversampling) {
+	if (!circuit.compiled) {
+		throw std::runtime_error("The circuit must be compiled before making voices of it, call Circuit::compile()");
+	}
+
+	if (circuit.start_from_operating_point && circuit.needs_operating_point) circuit.solve_operating_point();
+
+	initial = circuit.engine;
+	// the events nearest to the start apply before the first step
+	initial.apply_events(0.5 * timestep);
+
+	for (const ProcessInput &input : circuit.process_inputs) {
+		inputs.push_back({ .batch_id = input.batch_id, .gain = input.gain });
+	}
+	for (const ProcessOutput &output : circuit.process_outputs) {
+		const std::optional<std::pair<size_t, size_t>> rows = output.probe->get_voltage_rows();
+		if (!rows) {
+			throw std::runtime_error("The voices support only voltage outputs");
+		}
+		outputs.push_back({ .a_row = rows->first, .b_row = rows->second, .gain = output.gain });
+	}
+
+	matrix = lingebra::SparseMatrix<Lanes>::with_structure_of(circuit.matrix);
+	lu.set_column_order(circuit.lu.get_column_order());
+	rhs.assign(initial.get_num_rows(), Lanes(0.0));
+
+	voices.assign(Voices, initial);
+	input_offsets.resize(Voices * inputs.size());
+	input_last.resize(Voices * inputs.size());
+	decimators.assign(Voices * outputs.size(), initial_decimator);
+
+	for (size_t voice = 0; voice < Voices; ++voice) {
+		reset_voice(voice);
+	}
+}
+
+template <size_t Voices>
+void Polyphony<Voices>::reset_voice(size_t voice) {
+	// the sizes match, the copies reuse the storage
+	voices[voice] = initial;
+	voice_steps[voice] = 0;
+	restart_integration[voice] = true;
+	needs_factorization = true;
+
+	for (size_t k = 0; k < inputs.size(); ++k) {
+		input_offsets[voice * inputs.size() + k] = initial.voltage_sources.voltage[inputs[k].batch_id];
+		input_last[voice * inputs.size() + k] = 0.0;
+	}
+	for (size_t k = 0; k < outputs.size(); ++k) {
+		decimators[voice * outputs.size() + k] = initial_decimator;
+	}
+}
+
+template <size_t Voices>
+void Polyphony<Voices>::set_parameter(size_t voice, const Parameter &parameter, scalar value) noexcept {
+	voices[voice].set_parameter(parameter, value);
+
+	if (parameter.kind == ParameterKind::voltage) {
+		for (size_t k = 0; k < inputs.size(); ++k) {
+			if (inputs[k].batch_id == parameter.batch_id) input_offsets[voice * inputs.size() + k] = value;
+		}
+	}
+
+	if (changes_matrix(parameter.kind)) needs_factorization = true;
+}
+
+template <size_t Voices>
+void Polyphony<Voices>::factorize(const StampParams &params) {
+	auto &values = matrix.values();
+	std::fill(values.begin(), values.end(), Lanes(0.0));
+
+	for (size_t voice = 0; voice < Voices; ++voice) {
+		voices[voice].stamp_matrix(params);
+		const auto &stamp_values = voices[voice].get_stamp_values();
+
+		// slot i + 1 goes to values[slot_value_ids[i]], slot 0 is discarded
+		for (size_t i = 0; i < slot_value_ids.size(); ++i) {
+			values[slot_value_ids[i]][voice] += stamp_values[i + 1];
+		}
+	}
+
+	lu.factorize(matrix);
+	needs_factorization = false;
+}
+
+template <size_t Voices>
+void Polyphony<Voices>::solve() {
+	const size_t num_rows = rhs.size();
+
+	for (size_t voice = 0; voice < Voices; ++voice) {
+		const std::span<scalar> voice_rhs = voices[voice].get_system_rhs();
+		for (size_t i = 0; i < num_rows; ++i) rhs[i][voice] = voice_rhs[i];
+	}
+
+	lu.solve(std::span<Lanes>(rhs));
+
+	for (size_t voice = 0; voice < Voices; ++voice) {
+		const std::span<scalar> voice_rhs = voices[voice].get_system_rhs();
+		for (size_t i = 0; i < num_rows; ++i) voice_rhs[i] = rhs[i][voice];
+	}
+}
+
+template <size_t Voices>
+void Polyphony<Voices>::step() {
+	const StampParams params{
+		.timestep = timestep,
+		.timestep_inv = 1.0 / timestep,
+		.step = 0,
+		.integration = integration_coefficients(integration_method)
+	};
+
+	for (size_t voice = 0; voice < Voices; ++voice) {
+		if (!voices[voice].stamp_changed()) continue;
+		needs_factorization = true;
+		restart_integration[voice] = true;
+	}
+
+	if (needs_factorization) factorize(params);
+
+	// backward euler needs no history, the probe has the same matrix
+	const bool any_restart = std::find(restart_integration.begin(), restart_integration.end(), true) != restart_integration.end();
+	if (any_restart && integration_method != IntegrationMethod::backward_euler) {
+		const StampParams probe_params = restart_probe_params(params);
+
+		for (auto &voice : voices) voice.stamp_rhs(probe_params);
+		solve();
+
+		for (size_t voice = 0; voice < Voices; ++voice) {
+			if (restart_integration[voice]) voices[voice].restart_history(probe_params, params);
+		}
+	}
+	restart_integration.fill(false);
+
+	for (auto &voice : voices) voice.stamp_rhs(params);
+	solve();
+
+	for (size_t voice = 0; voice < Voices; ++voice) {
+		voices[voice].update(params);
+		// the events nearest to the end of the step
+		voices[voice].apply_events((voice_steps[voice] + 1.5) * timestep);
+		++voice_steps[voice];
+	}
+}
+
+template <size_t Voices>
+void Polyphony<Voices>::process(const float *const *in, float *const *out, size_t frames) noexcept {
+	const size_t num_inputs = inputs.size();
+	const size_t num_outputs = outputs.size();
+	size_t frame = 0;
+
+	if (!process_error) {
+		try {
+			for (; frame < frames; ++frame) {
+				for (size_t s = 1; s <= oversampling; ++s) {
+					const scalar weight = static_cast<scalar>(s) / oversampling;
+
+					for (size_t voice = 0; voice < Voices; ++voice) {
+						for (size_t k = 0; k < num_inputs; ++k) {
+							const size_t channel = voice * num_inputs + k;
+							const scalar sample = input_last[channel] + weight * (in[channel][frame] - input_last[channel]);
+							voices[voice].voltage_sources.voltage[inputs[k].batch_id] = input_offsets[channel] + inputs[k].gain * sample;
+						}
+					}
+
+					step();
+
+					for (size_t voice = 0; voice < Voices; ++voice) {
+						for (size_t k = 0; k < num_outputs; ++k) {
+							const Engine &engine = voices[voice];
+							decimators[voice * num_outputs + k].push(engine.get_value(outputs[k].a_row) - engine.get_value(outputs[k].b_row));
+						}
+					}
+				}
+
+				for (size_t channel = 0; channel < Voices * num_inputs; ++channel) {
+					input_last[channel] = in[channel][frame];
+				}
+				for (size_t channel = 0; channel < Voices * num_outputs; ++channel) {
+					out[channel][frame] = static_cast<float>(outputs[channel % num_outputs].gain * decimators[channel].get_output());
+				}
+			}
+		}
+		catch (const lingebra::singular_matrix_exception &) {
+			process_error = true;
+		}
+	}
+
+	for (size_t channel = 0; channel < Voices * num_outputs; ++channel) {
+		std::fill(out[channel] + frame, out[channel] + frames, 0.0f);
+	}
+}
+
+
+template class Polyphony<4>;
+template class Polyphony<8>;
+template class Polyphony<16>;
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../lingebra/lingebra.h"
+#include "circuit.h"
+#include "decimator.h"
+#include "engine.h"
+#include "parameter.h"
+#include "scalar.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+
+/* Voices copies of one compiled circuit solved together, for polyphonic instruments. Every voice
+ * has its own engine, so its own part values, switch states and schedule, the voices share the
+ * structure of the matrix. The matrices of all the voices are factorized as one sparse LU of
+ * lingebra::Lanes, so every step solves all the voices with a single pass over the factorization.
+ *
+ * A switch toggle or a matrix parameter change in any voice factorizes the lanes again. The pivots
+ * are shared by the lanes, a circuit whose matrix is regular in every voice on its own can still
+ * be singular as a whole if no row works as the pivot in all of them. */
+template <size_t Voices>
+class Polyphony {
+public:
+	using Lanes = lingebra::Lanes<scalar, Voices>;
+	static constexpr size_t num_voices = Voices;
+
+private:
+	struct Input {
+		size_t batch_id;
+		scalar gain;
+	};
+
+	struct Output {
+		size_t a_row;
+		size_t b_row;
+		scalar gain;
+	};
+
+	scalar timestep;
+	size_t oversampling;
+	IntegrationMethod integration_method;
+	std::vector<size_t> slot_value_ids;
+
+	// the state of a voice at its start
+	Engine initial;
+	std::vector<Engine> voices;
+	// steps since the start of every voice, the events of a voice are timed from its start
+	std::array<size_t, Voices> voice_steps{};
+	// the next step rebuilds the integration history of the voice
+	std::array<bool, Voices> restart_integration{};
+
+	lingebra::SparseMatrix<Lanes> matrix;
+	lingebra::SparseLU<Lanes> lu;
+	std::vector<Lanes> rhs;
+	bool needs_factorization = true;
+
+	std::vector<Input> inputs;
+	std::vector<Output> outputs;
+	// by voice * inputs.size() + input
+	std::vector<scalar> input_offsets;
+	std::vector<scalar> input_last;
+	// by voice * outputs.size() + output
+	std::vector<Decimator> decimators;
+	Decimator initial_decimator;
+
+	bool process_error = false;
+
+	void factorize(const StampParams &params);
+	// solves the systems in the RHS of every voice into their solutions
+	void solve();
+	void step();
+
+public:
+	// Takes the state, the inputs and the voltage outputs of the circuit, call right after compile.
+	// throws std::runtime_error
+	explicit Polyphony(Circuit &circuit);
+
+	// Restarts the voice from the initial state with its part values and schedule, like a note on.
+	// Does not allocate.
+	void reset_voice(size_t voice);
+
+	// the value of the part in one voice, applies with the next step
+	void set_parameter(size_t voice, const Parameter &parameter, scalar value) noexcept;
+
+	/* Like Circuit::process for all the voices, the channel of the input k of the voice v is
+	 * inputs[v * get_num_inputs() + k], the same for the outputs. Allocates nothing while no switch
+	 * toggles and no matrix parameter changes. Writes silence after a singular matrix. */
+	void process(const float *const *inputs, float *const *outputs, size_t frames) noexcept;
+
+	inline size_t get_num_inputs() const noexcept { return inputs.size(); }
+	inline size_t get_num_outputs() const noexcept { return outputs.size(); }
+	inline size_t get_latency() const noexcept { return Decimator::delay(oversampling) / oversampling; }
+	inline bool has_process_error() const noexcept { return process_error; }
+
+	// valid between the steps
+	inline scalar get_voltage(size_t voice, const Node &node) const { return voices[voice].get_value(node.node_id); }
+};
+
+extern template class Polyphony<4>;
+extern template class Polyphony<8>;
+extern template class Polyphony<16>;
@@ -0,0 +1,80 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+const char *phase_name(Phase phase) noexcept {
+	switch (phase) {
+		case Phase::assemble: return "assemble";
+		case Phase::factorize: return "factorize";
+		case Phase::low_rank_update: return "low_rank_update";
+		case Phase::cache_lookup: return "cache_lookup";
+		case Phase::stamp_rhs: return "stamp_rhs";
+		case Phase::solve: return "solve";
+		case Phase::update_parts: return "update_parts";
+		case Phase::record_scopes: return "record_scopes";
+		default: return "unknown";
+	}
+}
+
+void Profiler::reset() noexcept {
+	*this = Profiler{};
+}
+
+void Profiler::add_step(uint64_t ns) noexcept {
+	const size_t bucket = std::min<size_t>(std::bit_width(ns), num_buckets - 1);
+	++step_histogram[bucket];
+
+	++num_steps;
+	total_step_ns += ns;
+	if (ns > max_step_ns) max_step_ns = ns;
+}
+
+void Profiler::export_json(const fs::path &filepath, const std::vector<std::pair<std::string, size_t>> &counters) const {
+	std::ofstream file(filepath);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open output file: " + filepath.string());
+	}
+
+	const double mean_step_ns = num_steps ? static_cast<double>(total_step_ns) / num_steps : 0.0;
+
+	file << std::format("{{\n  \"steps\": {},\n  \"total_ms\": {:.3f},\n  \"mean_step_ns\": {:.1f},\n  \"max_step_ns\": {},\n",
+		num_steps, total_step_ns * 1e-6, mean_step_ns, max_step_ns);
+
+	file << "  \"phases\": {";
+	for (size_t p = 0; p < num_phases; ++p) {
+		const double share = total_step_ns ? static_cast<double>(phase_ns[p]) / total_step_ns : 0.0;
+		const double mean_ns = phase_calls[p] ? static_cast<double>(phase_ns[p]) / phase_calls[p] : 0.0;
+
+		file << std::format("{}\n    \"{}\": {{\"calls\": {}, \"total_ms\": {:.3f}, \"mean_ns\": {:.1f}, \"share\": {:.4f}}}",
+			p == 0 ? "" : ",", phase_name(static_cast<Phase>(p)), phase_calls[p], phase_ns[p] * 1e-6, mean_ns, share);
+	}
+	file << "\n  },\n";
+
+	file << "  \"counters\": {";
+	for (size_t i = 0; i < counters.size(); ++i) {
+		file << std::format("{}\n    \"{}\": {}", i == 0 ? "" : ",", counters[i].first, counters[i].second);
+	}
+	file << "\n  },\n";
+
+	// only the buckets with some steps, each with its upper bound
+	file << "  \"step_latency_ns\": [";
+	bool first = true;
+	for (size_t k = 0; k < num_buckets; ++k) {
+		if (step_histogram[k] == 0) continue;
+
+		const uint64_t upper = k + 1 < num_buckets ? uint64_t(1) << k : max_step_ns + 1;
+		file << std::format("{}\n    {{\"below\": {}, \"count\": {}}}", first ? "" : ",", upper, step_histogram[k]);
+		first = false;
+	}
+	file << "\n  ]\n}\n";
+}
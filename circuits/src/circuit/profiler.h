@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+
+// parts of the simulation step timed by the profiler
+enum class Phase : size_t {
+	// stamping the matrix values of the parts
+	assemble,
+	factorize,
+	low_rank_update,
+	cache_lookup,
+	stamp_rhs,
+	solve,
+	update_parts,
+	record_scopes,
+	count
+};
+
+/* Accumulates the time spent in every phase and a histogram of the step latencies. The phases of the
+ * adaptive steps that were rejected count towards the accepted step that follows them.
+ * Compiled in only with SIMLOGUE_PROFILE defined, otherwise every method is empty and
+ * the timers compile away, so the instrumented hot path costs nothing in normal builds. */
+class Profiler {
+public:
+#ifdef SIMLOGUE_PROFILE
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	using clock = std::chrono::steady_clock;
+
+	static constexpr size_t num_phases = static_cast<size_t>(Phase::count);
+	// bucket k counts the steps that took [2^(k - 1), 2^k) ns, the last one everything longer
+	static constexpr size_t num_buckets = 40;
+
+private:
+	std::array<uint64_t, num_phases> phase_ns{};
+	std::array<uint64_t, num_phases> phase_calls{};
+
+	std::array<uint64_t, num_buckets> step_histogram{};
+	uint64_t num_steps = 0;
+	uint64_t total_step_ns = 0;
+	uint64_t max_step_ns = 0;
+
+	clock::time_point step_start;
+
+	static uint64_t elapsed_ns(clock::time_point start) noexcept {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+	}
+
+public:
+	// adds the time until its destruction to the phase
+	class Timer {
+	private:
+		Profiler &profiler;
+		Phase phase;
+		clock::time_point start;
+
+	public:
+		inline Timer(Profiler &profiler, Phase phase) noexcept : profiler(profiler), phase(phase) {
+			if constexpr (enabled) start = clock::now();
+		}
+		inline ~Timer() noexcept {
+			if constexpr (enabled) profiler.add(phase, elapsed_ns(start));
+		}
+
+		Timer(const Timer &) = delete;
+		Timer &operator=(const Timer &) = delete;
+	};
+
+	void reset() noexcept;
+
+	inline void add(Phase phase, uint64_t ns) noexcept {
+		if constexpr (enabled) {
+			phase_ns[static_cast<size_t>(phase)] += ns;
+			++phase_calls[static_cast<size_t>(phase)];
+		}
+	}
+
+	inline void begin_step() noexcept {
+		if constexpr (enabled) step_start = clock::now();
+	}
+
+	inline void end_step() noexcept {
+		if constexpr (enabled) add_step(elapsed_ns(step_start));
+	}
+
+	void add_step(uint64_t ns) noexcept;
+
+	inline uint64_t get_num_steps() const noexcept { return num_steps; }
+	inline uint64_t get_phase_ns(Phase phase) const noexcept { return phase_ns[static_cast<size_t>(phase)]; }
+
+	// writes the timings and the given counters as JSON
+	void export_json(const fs::path &filepath, const std::vector<std::pair<std::string, size_t>> &counters) const;
+};
+
+const char *phase_name(Phase phase) noexcept;
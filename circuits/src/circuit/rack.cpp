@@ -0,0 +1,222 @@
+#include "rack.h"
+
+#include "circuit.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// the ring of a delay line wraps, the copies are split at its end
+static void write_ring(std::vector<float> &ring, size_t position, const float *samples, size_t count) {
+	const size_t start = position % ring.size();
+	const size_t first = std::min(count, ring.size() - start);
+	std::copy(samples, samples + first, ring.begin() + start);
+	std::copy(samples + first, samples + count, ring.begin());
+}
+
+static void read_ring(const std::vector<float> &ring, size_t position, float *samples, size_t count) {
+	const size_t start = position % ring.size();
+	const size_t first = std::min(count, ring.size() - start);
+	std::copy(ring.begin() + start, ring.begin() + start + first, samples);
+	std::copy(ring.begin(), ring.begin() + (count - first), samples + first);
+}
+
+
+Rack::Rack(size_t block_frames, size_t num_threads) : block_frames(block_frames), num_threads(num_threads), silence(block_frames, 0.0f) {
+	if (block_frames == 0) throw RackError("The block of the rack must have at least one frame");
+}
+
+Rack::~Rack() noexcept {
+	stop();
+}
+
+void Rack::check_port(const RackPort &port, bool input) const {
+	if (port.module >= modules.size()) {
+		throw RackError(std::format("The rack has no module {}", port.module));
+	}
+
+	const Circuit &circuit = *modules[port.module].circuit;
+	const size_t channels = input ? circuit.get_num_inputs() : circuit.get_num_outputs();
+	if (port.channel >= channels) {
+		throw RackError(std::format("The module {} has no {} {}, it has {}", port.module, input ? "input" : "output", port.channel, channels));
+	}
+}
+
+void Rack::check_stopped() const {
+	if (is_running()) throw RackError("The rack can't change while running, call Rack::stop()");
+}
+
+size_t Rack::add_module(std::unique_ptr<Circuit> circuit) {
+	check_stopped();
+
+	if (!circuit || !circuit->is_compiled()) {
+		throw RackError("The module must be compiled before adding it to the rack, call Circuit::compile()");
+	}
+
+	if (!modules.empty()) {
+		const scalar samplerate = modules.front().circuit->get_samplerate();
+		if (std::abs(circuit->get_samplerate() - samplerate) > 1e-9 * samplerate) {
+			throw RackError(std::format("The module runs at {} Hz, the rack at {} Hz", circuit->get_samplerate(), samplerate));
+		}
+	}
+
+	Module &module = modules.emplace_back();
+	module.routes.resize(circuit->get_num_inputs());
+	module.rack_outputs.resize(circuit->get_num_outputs());
+	module.delay_lines.resize(circuit->get_num_outputs());
+	module.input_block.resize(circuit->get_num_inputs() * block_frames);
+	module.output_block.resize(circuit->get_num_outputs() * block_frames);
+	module.input_channels.resize(circuit->get_num_inputs());
+	module.output_channels.resize(circuit->get_num_outputs());
+	module.circuit = std::move(circuit);
+
+	return modules.size() - 1;
+}
+
+void Rack::connect(const RackPort &output, const RackPort &input, Connection connection) {
+	check_stopped();
+	check_port(output, false);
+	check_port(input, true);
+
+	InputRoute &route = modules[input.module].routes[input.channel];
+	if (route.kind != RouteKind::silence) {
+		throw RackError(std::format("The input {} of the module {} is already driven", input.channel, input.module));
+	}
+
+	if (connection == Connection::direct) {
+		route = { .kind = RouteKind::direct, .from = output };
+		return;
+	}
+
+	route = { .kind = RouteKind::delayed, .from = output };
+
+	std::vector<float> &delay_line = modules[output.module].delay_lines[output.channel];
+	if (delay_line.empty()) delay_line.resize(2 * block_frames);
+}
+
+size_t Rack::add_input(const RackPort &input) {
+	check_stopped();
+	check_port(input, true);
+
+	InputRoute &route = modules[input.module].routes[input.channel];
+	if (route.kind != RouteKind::silence) {
+		throw RackError(std::format("The input {} of the module {} is already driven", input.channel, input.module));
+	}
+
+	route = { .kind = RouteKind::external, .from = { .module = 0, .channel = num_inputs } };
+	return num_inputs++;
+}
+
+size_t Rack::add_output(const RackPort &output) {
+	check_stopped();
+	check_port(output, false);
+
+	modules[output.module].rack_outputs[output.channel].push_back(num_outputs);
+	return num_outputs++;
+}
+
+bool Rack::start() {
+	check_stopped();
+	if (modules.empty()) throw RackError("The rack has no modules");
+
+	// a module runs after the modules driving its direct connections
+	std::vector<std::vector<size_t>> successors(modules.size());
+	for (size_t module_id = 0; module_id < modules.size(); ++module_id) {
+		for (const InputRoute &route : modules[module_id].routes) {
+			if (route.kind == RouteKind::direct) successors[route.from.module].push_back(module_id);
+		}
+	}
+	if (!TaskScheduler::topological_order(successors)) {
+		throw RackError("The direct connections make a loop, a feedback has to go through a delayed connection");
+	}
+
+	bool prepared = true;
+	for (Module &module : modules) {
+		prepared = module.circuit->prepare_processing() && prepared;
+
+		for (size_t k = 0; k < module.output_channels.size(); ++k) {
+			module.output_channels[k] = module.output_block.data() + k * block_frames;
+		}
+		// the first block reads silence from the connections
+		for (std::vector<float> &delay_line : module.delay_lines) {
+			std::fill(delay_line.begin(), delay_line.end(), 0.0f);
+		}
+	}
+	position = 0;
+
+	// more threads than modules would only wait
+	const size_t threads = num_threads > 0 ? num_threads : std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), modules.size());
+	scheduler = std::make_unique<TaskScheduler>(threads, std::move(successors), [this](size_t module_id) { run_module(modules[module_id]); });
+
+	return prepared;
+}
+
+void Rack::stop() noexcept {
+	scheduler.reset();
+}
+
+void Rack::run_module(Module &module) noexcept {
+	for (size_t k = 0; k < module.routes.size(); ++k) {
+		const InputRoute &route = module.routes[k];
+
+		switch (route.kind) {
+		case RouteKind::silence:
+			module.input_channels[k] = silence.data();
+			break;
+		case RouteKind::external:
+			module.input_channels[k] = block_inputs[route.from.channel] + block_offset;
+			break;
+		case RouteKind::direct:
+			// the module driving it already ran the block
+			module.input_channels[k] = modules[route.from.module].output_channels[route.from.channel];
+			break;
+		case RouteKind::delayed: {
+			// a block back, the output fills the other half of the ring in this block
+			float *samples = module.input_block.data() + k * block_frames;
+			read_ring(modules[route.from.module].delay_lines[route.from.channel], position + block_frames, samples, block_length);
+			module.input_channels[k] = samples;
+			break;
+		}
+		}
+	}
+
+	module.circuit->process(module.input_channels.data(), module.output_channels.data(), block_length);
+
+	for (size_t k = 0; k < module.output_channels.size(); ++k) {
+		const float *samples = module.output_channels[k];
+
+		if (!module.delay_lines[k].empty()) write_ring(module.delay_lines[k], position, samples, block_length);
+		for (size_t channel : module.rack_outputs[k]) {
+			std::copy(samples, samples + block_length, block_outputs[channel] + block_offset);
+		}
+	}
+}
+
+void Rack::process(const float *const *inputs, float *const *outputs, size_t frames) noexcept {
+	if (!is_running()) {
+		for (size_t channel = 0; channel < num_outputs; ++channel) {
+			std::fill(outputs[channel], outputs[channel] + frames, 0.0f);
+		}
+		return;
+	}
+
+	block_inputs = inputs;
+	block_outputs = outputs;
+
+	for (size_t offset = 0; offset < frames; offset += block_frames) {
+		block_offset = offset;
+		block_length = std::min(block_frames, frames - offset);
+
+		scheduler->run();
+
+		position += block_length;
+	}
+}
+
+bool Rack::has_process_error() const noexcept {
+	return std::ranges::any_of(modules, [](const Module &module) { return module.circuit->has_process_error(); });
+}
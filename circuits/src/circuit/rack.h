@@ -0,0 +1,132 @@
+#pragma once
+
+#include "circuit.h"
+#include "scalar.h"
+#include "task_scheduler.h"
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+class RackError : public std::runtime_error {
+public:
+	explicit RackError(const std::string &message) : std::runtime_error(message) {}
+};
+
+
+// a process() channel of a module of the rack, an input or an output by the context
+struct RackPort {
+	size_t module;
+	size_t channel;
+};
+
+enum class Connection {
+	// one block late, the modules on both sides run at once
+	delayed,
+	// in the same block, the input module runs after the output one
+	direct
+};
+
+
+/* Circuits connected from the outputs of one to the inputs of another. Every block the modules run as tasks
+ * of a work-stealing scheduler, a module after the modules driving its direct connections. A delayed
+ * connection reads what its output wrote in the previous blocks, so it does not order the modules, and every
+ * feedback loop has to go through one. Splitting a big patch into modules trades these delays for using all
+ * the cores. */
+class Rack {
+private:
+	enum class RouteKind {
+		silence,
+		delayed,
+		direct,
+		external
+	};
+
+	// where an input of a module takes its samples from
+	struct InputRoute {
+		RouteKind kind = RouteKind::silence;
+		// the output of the module for a connection, the input channel of the rack for an external input
+		RackPort from{};
+	};
+
+	struct Module {
+		std::unique_ptr<Circuit> circuit;
+		std::vector<InputRoute> routes;
+		// the output channels of the rack fed by the outputs of the module, by the output
+		std::vector<std::vector<size_t>> rack_outputs;
+
+		// the outputs of delayed connections write into a ring of two blocks, empty for the others
+		std::vector<std::vector<float>> delay_lines;
+
+		// the channels of the block handed to Circuit::process
+		std::vector<float> input_block;
+		std::vector<float> output_block;
+		std::vector<const float *> input_channels;
+		std::vector<float *> output_channels;
+	};
+
+	size_t block_frames;
+	size_t num_threads;
+	std::vector<Module> modules;
+	size_t num_inputs = 0;
+	size_t num_outputs = 0;
+	std::vector<float> silence;
+
+	std::unique_ptr<TaskScheduler> scheduler;
+
+	// the block the modules run, written by the calling thread between the blocks
+	const float *const *block_inputs = nullptr;
+	float *const *block_outputs = nullptr;
+	size_t block_offset = 0;
+	size_t block_length = 0;
+	// frames since the start, the position in the delay lines
+	size_t position = 0;
+
+	void check_port(const RackPort &port, bool input) const;
+	void check_stopped() const;
+
+	void run_module(Module &module) noexcept;
+
+public:
+	// 0 threads takes one per module up to the count of the cores. throws RackError
+	explicit Rack(size_t block_frames = 256, size_t num_threads = 0);
+	~Rack() noexcept;
+
+	Rack(const Rack &) = delete;
+	Rack &operator=(const Rack &) = delete;
+
+	// Takes a compiled circuit with its inputs and outputs declared, returns the index of the module.
+	// All the modules run at the same samplerate. throws RackError
+	size_t add_module(std::unique_ptr<Circuit> circuit);
+	inline Circuit &get_module(size_t module_id) { return *modules[module_id].circuit; }
+	inline size_t get_num_modules() const { return modules.size(); }
+
+	// The output of a module drives an input of a module, a delayed connection block_frames frames late. An output
+	// may drive several inputs, an input takes one output or one input of the rack. throws RackError
+	void connect(const RackPort &output, const RackPort &input, Connection connection = Connection::delayed);
+	// returns the channel of the rack, throws RackError
+	size_t add_input(const RackPort &input);
+	size_t add_output(const RackPort &output);
+	inline size_t get_num_inputs() const { return num_inputs; }
+	inline size_t get_num_outputs() const { return num_outputs; }
+
+	/* Prepares the processing of every module and starts the worker threads. Returns false if a module
+	 * could not factorize every switch state it will reach beforehand, see Circuit::prepare_processing.
+	 * The modules must not be changed or run elsewhere until stop. throws RackError if the direct
+	 * connections make a loop */
+	bool start();
+	void stop() noexcept;
+	inline bool is_running() const noexcept { return scheduler != nullptr; }
+
+	/* Like Circuit::process for the whole rack, runs the blocks of up to block_frames frames on the workers
+	 * and waits for them. Allocates nothing, writes silence when the rack is not running. */
+	void process(const float *const *inputs, float *const *outputs, size_t frames) noexcept;
+
+	bool has_process_error() const noexcept;
+	inline size_t get_block_frames() const noexcept { return block_frames; }
+	// seconds the module takes for a block, averaged over the last blocks, 0 when not running
+	inline scalar get_module_cost(size_t module_id) const noexcept { return scheduler ? scheduler->get_cost(module_id) : 0.0; }
+	inline size_t get_num_threads() const noexcept { return scheduler ? scheduler->get_num_threads() : 0; }
+};
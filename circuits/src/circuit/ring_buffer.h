@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+
+/* Lock-free ring buffer for one producer and one consumer thread. The capacity is rounded up
+ * to a power of two, the positions only grow and wrap by the mask. Only the producer calls push
+ * and only the consumer calls pop, both may call the size queries. */
+template <typename T>
+class RingBuffer {
+private:
+	std::vector<T> data;
+	size_t mask;
+
+	// on separate cache lines, each is written by one side only
+	alignas(64) std::atomic<size_t> write_pos{ 0 };
+	alignas(64) std::atomic<size_t> read_pos{ 0 };
+
+public:
+	explicit RingBuffer(size_t capacity) : data(std::bit_ceil(std::max<size_t>(capacity, 1))), mask(data.size() - 1) {}
+
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer &operator=(const RingBuffer &) = delete;
+
+	inline size_t capacity() const noexcept { return data.size(); }
+
+	// a lower bound for the consumer, exact for the producer
+	inline size_t size() const noexcept {
+		return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+	}
+	inline size_t free_space() const noexcept { return capacity() - size(); }
+
+	// pushes as many values as fit, returns their count
+	size_t push(std::span<const T> values) noexcept {
+		const size_t write = write_pos.load(std::memory_order_relaxed);
+		const size_t read = read_pos.load(std::memory_order_acquire);
+		const size_t count = std::min(values.size(), capacity() - (write - read));
+
+		for (size_t i = 0; i < count; ++i) {
+			data[(write + i) & mask] = values[i];
+		}
+
+		write_pos.store(write + count, std::memory_order_release);
+		return count;
+	}
+
+	// pops up to values.size() values, returns their count
+	size_t pop(std::span<T> values) noexcept {
+		const size_t read = read_pos.load(std::memory_order_relaxed);
+		const size_t write = write_pos.load(std::memory_order_acquire);
+		const size_t count = std::min(values.size(), write - read);
+
+		for (size_t i = 0; i < count; ++i) {
+			values[i] = data[(read + i) & mask];
+		}
+
+		read_pos.store(read + count, std::memory_order_release);
+		return count;
+	}
+};
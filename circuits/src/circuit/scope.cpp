@@ -1,56 +1,40 @@
 #include "scope.h"
 
 #include <format>
-#include <fstream>
 
 #include "part.h"
 #include "pin.h"
 #include "scalar.h"
 #include <cassert>
-#include <filesystem>
 #include <iostream>
-#include <stdexcept>
+#include <vector>
 
 
-Scope::Scope(const ConstPin &a, const ConstPin &b, const fs::path &export_path, const std::string &values_name) :
+Scope::Scope(const ConstPin &a, const ConstPin &b, const std::string &values_name, const std::string &unit) :
 	a(a), b(b),
-	export_path(export_path),
-	values_name(values_name) {
+	values_name(values_name),
+	unit(unit) {
 	name = std::format("{}-between-{}-and-{}", values_name, a.name, b.name);
 }
 
-void Scope::export_table() const {
-	fs::path filename = std::format("{}.csv", name);
-	fs::path filepath = export_path / filename;
-	std::ofstream file(filepath);
-	if (!file.is_open()) {
-		throw std::runtime_error("Failed to open output file: " + filepath.string());
-	}
-
-	file << "time," << values_name << "\n";
-
-	for (size_t i = 0; i < times.size(); ++i) {
-		file << times[i] << "," << values[i] << "\n";
-	}
-
-	file.close();
-
-	fs::remove(export_path.parent_path() / "latest" / filename);
-	fs::copy_file(filepath, export_path.parent_path() / "latest" / filename);
-
-	std::cout << "Exported " << values_name << " table " << filepath << "\n";
+void Scope::set_decimation(size_t factor) {
+	decimator = Decimator(factor);
 }
 
-void Scope::plot(sciplot::Plot2D &p) const {
+void Scope::plot(sciplot::Plot2D &p, const Timebase &timebase) const {
 	using namespace sciplot;
 
 	p.palette("paired");
 
+	std::vector<double> x(values.size());
+	for (size_t i = 0; i < x.size(); ++i) {
+		x[i] = timebase.time(i);
+	}
+
 	if constexpr (std::is_same_v<scalar, double>) {
-		p.drawCurve(times, values);
+		p.drawCurve(x, values);
 	}
 	else {
-		std::vector<double> x(times.begin(), times.end());
 		std::vector<double> y(values.begin(), values.end());
 
 		p.drawCurve(x, y);
@@ -65,24 +49,26 @@ void Scope::plot(sciplot::Plot2D &p) const {
 }
 
 
-VoltageScope::VoltageScope(const ConstPin &a, const ConstPin &b, const fs::path &export_path) :
-	Scope(a, b, export_path, "voltage") {
+VoltageScope::VoltageScope(const ConstPin &a, const ConstPin &b) :
+	Scope(a, b, "voltage", "V") {
+}
+
+void VoltageScope::bind(std::span<const scalar> solution) {
+	this->solution = solution;
+	a_id = a.node->node_id;
+	b_id = b.node->node_id;
 }
 
-void VoltageScope::record(scalar time) {
-	scalar voltage = a.node->voltage - b.node->voltage;
-	times.push_back(time);
-	values.push_back(voltage);
+scalar VoltageScope::read() const {
+	return solution[a_id] - solution[b_id];
 }
 
-CurrentScope::CurrentScope(const ConstPin &a, const ConstPin &b, const fs::path &export_path) :
-	Scope(a, b, export_path, "current") {
+CurrentScope::CurrentScope(const ConstPin &a, const ConstPin &b) :
+	Scope(a, b, "current", "A") {
 	assert(a.owner == b.owner);
 }
 
-void CurrentScope::record(scalar time) {
+scalar CurrentScope::read() const {
 	const Part *part = a.owner;
-	scalar current = part->get_current_between(a, b);
-	times.push_back(time);
-	values.push_back(current);
+	return part->get_current_between(a, b);
 }
@@ -1,50 +1,96 @@
 #pragma once
 
+#include "decimator.h"
 #include "pin.h"
 #include "scalar.h"
-#include <filesystem>
 #include <memory>
+#include <optional>
 #include <sciplot/sciplot.hpp>
+#include <span>
+#include <string>
+#include <utility>
 #include <vector>
 
 
-namespace fs = std::filesystem;
+// the times of the recorded samples, the scopes record together so all of them share it
+struct Timebase {
+	scalar start = 0.0;
+	scalar period = 0.0;
+	size_t num_samples = 0;
 
+	inline scalar time(size_t sample) const noexcept { return start + sample * period; }
+	inline void append(scalar time) noexcept {
+		if (num_samples == 0) start = time;
+		++num_samples;
+	}
+};
 
-class Scope {
-private:
-	fs::path export_path;
 
+class Scope {
 protected:
-	std::vector<scalar> times;
+	// the samples of the timebase of the circuit
 	std::vector<scalar> values;
 
 	ConstPin a;
 	ConstPin b;
 
 	std::string values_name;
+	std::string unit;
 	std::string name;
 
+	// the recorded states are decimated to the samplerate of the tables
+	Decimator decimator;
+
 public:
-	Scope(const ConstPin &a, const ConstPin &b, const fs::path &export_path, const std::string &values_name);
+	Scope(const ConstPin &a, const ConstPin &b, const std::string &values_name, const std::string &unit);
+
+	// called by Circuit::compile, see Part::bind
+	virtual void bind(std::span<const scalar> solution) {}
 
-	virtual void record(scalar time) = 0;
+	// the value at the current state of the circuit
+	virtual scalar read() const = 0;
+	// the solution rows whose difference is the value, none unless it is a voltage, valid after bind
+	virtual std::optional<std::pair<size_t, size_t>> get_voltage_rows() const { return std::nullopt; }
 
-	void export_table() const;
-	void plot(sciplot::Plot2D &p) const;
+	// Every recorded state passes the decimator, an output sample belongs to the state it is centered on.
+	// Call before recording, resets the filter.
+	void set_decimation(size_t factor);
+
+	// passes the current state to the decimator, true when get_output is a new sample
+	inline bool decimate() { return decimator.push(read()); }
+	// passes a value interpolated between two states
+	inline bool decimate(scalar value) { return decimator.push(value); }
+	inline scalar get_output() const noexcept { return decimator.get_output(); }
+
+	// appends the new sample to the table
+	inline void keep_output() { values.push_back(decimator.get_output()); }
+	inline void clear() { values.clear(); }
+
+	inline const std::string &get_name() const { return name; }
+	inline const std::string &get_unit() const { return unit; }
+	inline std::span<const scalar> get_values() const { return values; }
+
+	void plot(sciplot::Plot2D &p, const Timebase &timebase) const;
 };
 
 
 class VoltageScope : public Scope {
+private:
+	std::span<const scalar> solution;
+	size_t a_id = 0;
+	size_t b_id = 0;
+
 public:
-	VoltageScope(const ConstPin &a, const ConstPin &b, const fs::path &export_path);
+	VoltageScope(const ConstPin &a, const ConstPin &b);
 
-	void record(scalar time) override;
+	void bind(std::span<const scalar> solution) override;
+	scalar read() const override;
+	inline std::optional<std::pair<size_t, size_t>> get_voltage_rows() const override { return std::pair{ a_id, b_id }; }
 };
 
 class CurrentScope : public Scope {
 public:
-	CurrentScope(const ConstPin &a, const ConstPin &b, const fs::path &export_path);
+	CurrentScope(const ConstPin &a, const ConstPin &b);
 
-	void record(scalar time) override;
+	scalar read() const override;
 };
\ No newline at end of file
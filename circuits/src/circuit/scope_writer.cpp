@@ -0,0 +1,152 @@
+#include "scope_writer.h"
+
+#include "scope.h"
+#include "table_file.h"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+ScopeWriter::ScopeWriter(const fs::path &path, std::span<const std::unique_ptr<Scope>> scopes, bool append) :
+	path(path),
+	num_columns(scopes.size()),
+	pool(pool_chunks),
+	full_chunks(pool_chunks),
+	free_chunks(pool_chunks) {
+	std::string header = "time";
+	for (const std::unique_ptr<Scope> &scope : scopes) header += "," + scope->get_name();
+
+	file = std::fopen(path.string().c_str(), append ? "a" : "w");
+	if (!file || (!append && std::fprintf(file, "%s\n", header.c_str()) < 0)) {
+		if (file) std::fclose(file);
+		throw std::runtime_error("Failed to open output file: " + path.string());
+	}
+
+	for (ScopeChunk &pooled : pool) {
+		pooled.values.resize(chunk_rows * num_columns);
+	}
+
+	// the simulation starts with a chunk, the rest waits in the pool
+	chunk = &pool.front();
+	for (size_t i = 1; i < pool.size(); ++i) {
+		ScopeChunk *free = &pool[i];
+		free_chunks.push(std::span<ScopeChunk *const>(&free, 1));
+	}
+
+	text.reserve(chunk_rows * (num_columns + 1) * 16);
+	thread = std::jthread([this](std::stop_token stop) { write_chunks(stop); });
+}
+
+ScopeWriter::~ScopeWriter() noexcept {
+	close();
+}
+
+void ScopeWriter::submit(ScopeChunk *full) noexcept {
+	// the pool fits the ring, the push always succeeds
+	full_chunks.push(std::span<ScopeChunk *const>(&full, 1));
+	submitted.fetch_add(1, std::memory_order_release);
+	submitted.notify_one();
+}
+
+ScopeChunk *ScopeWriter::acquire() {
+	ScopeChunk *empty;
+	while (true) {
+		const size_t seen = released.load(std::memory_order_acquire);
+		if (free_chunks.pop(std::span<ScopeChunk *>(&empty, 1)) == 1) break;
+
+		++stalls;
+		released.wait(seen, std::memory_order_acquire);
+	}
+
+	empty->rows = 0;
+	return empty;
+}
+
+void ScopeWriter::write_row(const Timebase &timebase, std::span<const std::unique_ptr<Scope>> scopes) {
+	if (chunk->rows == 0) {
+		chunk->timebase = timebase;
+		chunk->first_sample = timebase.num_samples - 1;
+	}
+
+	scalar *row = chunk->values.data() + chunk->rows * num_columns;
+	for (size_t i = 0; i < num_columns; ++i) {
+		row[i] = scopes[i]->get_output();
+	}
+
+	if (++chunk->rows == chunk_rows) {
+		submit(chunk);
+		chunk = acquire();
+	}
+}
+
+void ScopeWriter::write_chunks(std::stop_token stop) {
+	while (true) {
+		const size_t seen = submitted.load(std::memory_order_acquire);
+
+		ScopeChunk *full;
+		while (full_chunks.pop(std::span<ScopeChunk *>(&full, 1)) == 1) {
+			// after an error the chunks only go back to the pool
+			if (!error) {
+				try {
+					write(*full);
+				}
+				catch (...) {
+					error = std::current_exception();
+				}
+			}
+
+			free_chunks.push(std::span<ScopeChunk *const>(&full, 1));
+			released.fetch_add(1, std::memory_order_release);
+			released.notify_one();
+		}
+
+		// the last chunks are submitted before the stop
+		if (stop.stop_requested() && full_chunks.size() == 0) return;
+		submitted.wait(seen, std::memory_order_acquire);
+	}
+}
+
+void ScopeWriter::write(const ScopeChunk &full) {
+	text.clear();
+	for (size_t j = 0; j < full.rows; ++j) {
+		append_csv_number(text, full.timebase.time(full.first_sample + j));
+
+		const scalar *row = full.values.data() + j * num_columns;
+		for (size_t i = 0; i < num_columns; ++i) {
+			text += ',';
+			append_csv_number(text, row[i]);
+		}
+		text += '\n';
+	}
+
+	if (std::fwrite(text.data(), 1, text.size(), file) != text.size()) {
+		throw std::runtime_error("Failed to write the table " + path.string());
+	}
+}
+
+void ScopeWriter::close() noexcept {
+	if (finished) return;
+	finished = true;
+
+	if (chunk->rows > 0) submit(chunk);
+	chunk = nullptr;
+
+	thread.request_stop();
+	// wakes the thread waiting for a chunk
+	submitted.fetch_add(1, std::memory_order_release);
+	submitted.notify_one();
+	thread.join();
+
+	if (std::fclose(file) != 0 && !error) {
+		error = std::make_exception_ptr(std::runtime_error("Failed to write the table " + path.string()));
+	}
+}
+
+void ScopeWriter::finish() {
+	close();
+	if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "scalar.h"
+#include "scope.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+
+// recorded rows of all the scopes, the unit the writer thread takes
+struct ScopeChunk {
+	// the timebase of the rows
+	Timebase timebase;
+	// the sample of the timebase in the first row
+	size_t first_sample = 0;
+	size_t rows = 0;
+	// row by row, a value of every scope in a row
+	std::vector<scalar> values;
+};
+
+
+/* Writes the table of the scopes while the simulation runs. The rows fill the chunks of a fixed pool and
+ * the full ones go to a writer thread, which appends them to the table and returns them to the pool, so
+ * the memory does not grow with the length of the run. The simulation thread does no I/O, it only waits
+ * when the disk falls behind by the whole pool. */
+class ScopeWriter {
+public:
+	static constexpr size_t chunk_rows = 4096;
+	static constexpr size_t pool_chunks = 8;
+
+private:
+	fs::path path;
+	std::FILE *file = nullptr;
+	size_t num_columns;
+
+	std::vector<ScopeChunk> pool;
+	RingBuffer<ScopeChunk *> full_chunks;
+	RingBuffer<ScopeChunk *> free_chunks;
+	// count the chunks passed each way, the receiving side waits on them
+	std::atomic<size_t> submitted{ 0 };
+	std::atomic<size_t> released{ 0 };
+
+	// filled by the simulation thread
+	ScopeChunk *chunk = nullptr;
+
+	// the writer thread
+	std::string text;
+	std::exception_ptr error;
+
+	size_t stalls = 0;
+	bool finished = false;
+
+	std::jthread thread;
+
+	void submit(ScopeChunk *full) noexcept;
+	ScopeChunk *acquire();
+	void write_chunks(std::stop_token stop);
+	void write(const ScopeChunk &full);
+	// stops the thread after the last chunk and closes the table
+	void close() noexcept;
+
+public:
+	/* Opens the table with a column for each scope, append continues the table of an earlier run with the
+	 * same scopes. throws std::runtime_error */
+	ScopeWriter(const fs::path &path, std::span<const std::unique_ptr<Scope>> scopes, bool append);
+	~ScopeWriter() noexcept;
+
+	ScopeWriter(const ScopeWriter &) = delete;
+	ScopeWriter &operator=(const ScopeWriter &) = delete;
+
+	// the simulation thread, the outputs of the scopes as the last sample of the timebase
+	void write_row(const Timebase &timebase, std::span<const std::unique_ptr<Scope>> scopes);
+
+	// Writes the rest and closes the table. Rethrows an error of the writer thread.
+	void finish();
+
+	inline const fs::path &get_path() const noexcept { return path; }
+	// times the simulation waited for the disk
+	inline size_t get_stalls() const noexcept { return stalls; }
+};
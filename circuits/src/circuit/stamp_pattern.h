@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+using StampSlot = size_t;
+
+// Positions of the matrix entries the parts write to. Every part reserves its entries once
+// when the circuit is built and then writes the values to the returned slots on every stamp.
+class StampPattern {
+public:
+	// entries in the ground row or column all get this slot, its value is never read
+	static constexpr StampSlot discarded_slot = 0;
+
+private:
+	// row and column id of the ground node, it is not part of the system
+	size_t ground;
+
+	// position of the slot i + 1
+	std::vector<std::pair<size_t, size_t>> positions;
+
+public:
+	explicit StampPattern(size_t ground) : ground(ground) {}
+
+	StampSlot reserve(size_t row, size_t col) {
+		if (row == ground || col == ground) return discarded_slot;
+
+		positions.push_back({ row, col });
+		return positions.size();
+	}
+
+	// including the discarded slot
+	size_t num_slots() const noexcept { return positions.size() + 1; }
+
+	const std::vector<std::pair<size_t, size_t>> &get_positions() const noexcept { return positions; }
+};
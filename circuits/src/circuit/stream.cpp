@@ -0,0 +1,167 @@
+#include "stream.h"
+
+#include "circuit.h"
+#include "scalar.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+PcmFileSink::PcmFileSink(const fs::path &path, PcmFormat format) : format(format) {
+	if (path == "-") {
+		file = stdout;
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	}
+	else {
+		file = std::fopen(path.string().c_str(), "wb");
+		owns_file = true;
+	}
+
+	if (!file) throw StreamError("Failed to open the stream output: " + path.string());
+}
+
+PcmFileSink::~PcmFileSink() {
+	if (owns_file) std::fclose(file);
+	else std::fflush(file);
+}
+
+void PcmFileSink::write(std::span<const float> samples) {
+	size_t written;
+
+	if (format == PcmFormat::int16) {
+		if (converted.size() < samples.size()) converted.resize(samples.size());
+
+		for (size_t i = 0; i < samples.size(); ++i) {
+			converted[i] = static_cast<int16_t>(std::lround(std::clamp(samples[i], -1.0f, 1.0f) * 32767.0f));
+		}
+		written = std::fwrite(converted.data(), sizeof(int16_t), samples.size(), file);
+	}
+	else {
+		written = std::fwrite(samples.data(), sizeof(float), samples.size(), file);
+	}
+
+	// a reader of a FIFO gets the period right away
+	if (written != samples.size() || std::fflush(file) != 0) throw StreamError("Failed to write the stream output");
+}
+
+
+AudioStream::AudioStream(Circuit &circuit, AudioSink &sink, StreamSettings settings) :
+	circuit(circuit),
+	sink(sink),
+	settings(settings),
+	channels(circuit.get_num_scopes()),
+	buffer(settings.buffer_frames * circuit.get_num_scopes()) {
+	if (!circuit.is_compiled()) throw StreamError("The circuit must be compiled before streaming, call Circuit::compile()");
+	if (channels == 0) throw StreamError("Nothing to stream, the circuit has no scopes");
+	if (settings.period_frames == 0 || settings.period_frames > settings.buffer_frames) {
+		throw StreamError(std::format("The period of {} frames must be positive and fit the buffer of {} frames", settings.period_frames, settings.buffer_frames));
+	}
+}
+
+void AudioStream::produce(std::stop_token stop, size_t num_frames, std::atomic<bool> &done, std::exception_ptr &error) {
+	std::vector<scalar> frame(channels);
+	std::vector<float> samples(channels);
+
+	try {
+		for (size_t f = 0; f < num_frames; ++f) {
+			circuit.render_frame(frame);
+			std::copy(frame.begin(), frame.end(), samples.begin());
+
+			// whole frames only, the consumer takes whole frames
+			while (buffer.free_space() < channels) {
+				if (stop.stop_requested()) {
+					done.store(true, std::memory_order_release);
+					return;
+				}
+				std::this_thread::yield();
+			}
+
+			buffer.push(samples);
+			++stats.frames_rendered;
+		}
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+
+	done.store(true, std::memory_order_release);
+}
+
+void AudioStream::consume(size_t num_frames, const std::atomic<bool> &done) {
+	using clock = std::chrono::steady_clock;
+
+	std::vector<float> period(settings.period_frames * channels);
+
+	// start with the buffer full, the latency is then the whole buffer
+	const size_t prefill = std::min(settings.buffer_frames, num_frames) * channels;
+	while (buffer.size() < prefill && !done.load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+
+	const auto period_duration = std::chrono::duration_cast<clock::duration>(
+		std::chrono::duration<double>(settings.period_frames / circuit.get_samplerate())
+	);
+	auto next_period = clock::now();
+
+	size_t written = 0;
+	while (written < num_frames) {
+		const size_t frames = std::min(settings.period_frames, num_frames - written);
+		const std::span<float> samples = std::span<float>(period).first(frames * channels);
+
+		if (settings.paced) {
+			std::this_thread::sleep_until(next_period);
+			next_period += period_duration;
+		}
+		else {
+			while (buffer.size() < samples.size() && !done.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+		}
+
+		const size_t got = buffer.pop(samples);
+
+		if (got < samples.size()) {
+			// the simulation stopped early, there is nothing more to play
+			if (done.load(std::memory_order_acquire) && buffer.size() == 0) {
+				if (got > 0) sink.write(samples.first(got));
+				stats.frames_written += got / channels;
+				break;
+			}
+
+			++stats.underruns;
+			stats.silent_frames += (samples.size() - got) / channels;
+			std::fill(samples.begin() + got, samples.end(), 0.0f);
+		}
+
+		sink.write(samples);
+		written += frames;
+		stats.frames_written += frames;
+	}
+}
+
+void AudioStream::run(size_t num_frames) {
+	std::atomic<bool> done{ false };
+	std::exception_ptr error;
+
+	{
+		// stops and joins the simulation thread also when the sink throws
+		std::jthread producer([&](std::stop_token stop) { produce(stop, num_frames, done, error); });
+		consume(num_frames, done);
+	}
+
+	if (error) std::rethrow_exception(error);
+}
+
+void AudioStream::run_for_seconds(scalar secs) {
+	run(static_cast<size_t>(std::llround(secs * circuit.get_samplerate())));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "scalar.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+class Circuit;
+
+
+class StreamError : public std::runtime_error {
+public:
+	explicit StreamError(const std::string &message) : std::runtime_error(message) {}
+};
+
+
+// Receives the interleaved frames of the stream, one period at a time, from the consumer thread.
+class AudioSink {
+public:
+	virtual ~AudioSink() = default;
+
+	virtual void write(std::span<const float> samples) = 0;
+};
+
+enum class PcmFormat {
+	float32,
+	int16
+};
+
+// Raw little endian PCM to a file, a FIFO or the standard output ("-"), the local stand-in for a sound card.
+class PcmFileSink : public AudioSink {
+private:
+	std::FILE *file = nullptr;
+	bool owns_file = false;
+	PcmFormat format;
+
+	std::vector<int16_t> converted;
+
+public:
+	// throws StreamError
+	PcmFileSink(const fs::path &path, PcmFormat format = PcmFormat::float32);
+	~PcmFileSink() override;
+
+	PcmFileSink(const PcmFileSink &) = delete;
+	PcmFileSink &operator=(const PcmFileSink &) = delete;
+
+	void write(std::span<const float> samples) override;
+};
+
+
+struct StreamSettings {
+	// capacity of the ring buffer, the latency is up to this many frames
+	size_t buffer_frames = 4096;
+	// frames the sink takes at once
+	size_t period_frames = 256;
+	// take the periods at the samplerate like a sound card, otherwise as fast as the simulation renders them
+	bool paced = true;
+};
+
+struct StreamStats {
+	size_t frames_rendered = 0;
+	size_t frames_written = 0;
+	// periods the simulation did not fill in time, they were padded with silence
+	size_t underruns = 0;
+	size_t silent_frames = 0;
+};
+
+
+/* Streams the scopes of the circuit to a sink. A simulation thread renders the frames into a
+ * lock-free ring buffer, the calling thread takes them a period at a time and writes them to the sink.
+ * Every scope is one channel. */
+class AudioStream {
+private:
+	Circuit &circuit;
+	AudioSink &sink;
+	StreamSettings settings;
+	size_t channels;
+
+	RingBuffer<float> buffer;
+	StreamStats stats;
+
+	// the simulation thread
+	void produce(std::stop_token stop, size_t num_frames, std::atomic<bool> &done, std::exception_ptr &error);
+	// the calling thread
+	void consume(size_t num_frames, const std::atomic<bool> &done);
+
+public:
+	// the circuit must be compiled and must not run elsewhere while streaming
+	AudioStream(Circuit &circuit, AudioSink &sink, StreamSettings settings = {});
+
+	// blocks until the frames are written, rethrows an error of the simulation thread
+	void run(size_t num_frames);
+	void run_for_seconds(scalar secs);
+
+	inline size_t get_channels() const noexcept { return channels; }
+	inline const StreamStats &get_stats() const noexcept { return stats; }
+};
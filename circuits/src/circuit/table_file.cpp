@@ -0,0 +1,317 @@
+#include "table_file.h"
+
+#include "scalar.h"
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <span>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// the values are written and mapped as they are in memory
+static_assert(std::endian::native == std::endian::little, "The binary tables are little endian");
+
+
+template <typename T>
+static void put(std::vector<std::byte> &out, T value) {
+	const auto bytes = std::bit_cast<std::array<std::byte, sizeof(T)>>(value);
+	out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+static void put_string(std::vector<std::byte> &out, const std::string &text) {
+	put(out, static_cast<uint32_t>(text.size()));
+	const std::byte *bytes = reinterpret_cast<const std::byte *>(text.data());
+	out.insert(out.end(), bytes, bytes + text.size());
+}
+
+void append_csv_number(std::string &text, double value) {
+	char number[32];
+	const std::to_chars_result result = std::to_chars(number, number + sizeof(number), value, std::chars_format::general, 6);
+	text.append(number, result.ptr);
+}
+
+// the time and a column for each name, the values by (column, sample)
+template <typename TimeOf, typename ValueOf>
+static void write_csv_rows(const fs::path &path, std::span<const std::string> names, size_t num_samples, TimeOf time_of, ValueOf value_of) {
+	std::FILE *file = std::fopen(path.string().c_str(), "w");
+	if (!file) throw TableError("Failed to open output file: " + path.string());
+
+	std::string text = "time";
+	for (const std::string &name : names) text += "," + name;
+	text += '\n';
+
+	bool written = true;
+	for (size_t i = 0; i < num_samples && written; ++i) {
+		append_csv_number(text, time_of(i));
+		for (size_t c = 0; c < names.size(); ++c) {
+			text += ',';
+			append_csv_number(text, value_of(c, i));
+		}
+		text += '\n';
+
+		// written in blocks
+		if (text.size() >= 1 << 16) {
+			written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+			text.clear();
+		}
+	}
+
+	written = written && std::fwrite(text.data(), 1, text.size(), file) == text.size();
+	written = std::fclose(file) == 0 && written;
+
+	if (!written) throw TableError("Failed to write the table " + path.string());
+}
+
+// the columns must have the same length
+template <typename T>
+static size_t get_num_samples(std::span<const BasicTableColumn<T>> columns) {
+	const size_t num_samples = columns.empty() ? 0 : columns.front().values.size();
+	for (const BasicTableColumn<T> &column : columns) {
+		if (column.values.size() != num_samples) {
+			throw TableError(std::format("The column {} has {} samples, the table {}", column.name, column.values.size(), num_samples));
+		}
+	}
+	return num_samples;
+}
+
+void write_csv_table(const fs::path &path, scalar start_time, scalar sample_period, std::span<const TableColumn> columns) {
+	const size_t num_samples = get_num_samples(columns);
+
+	std::vector<std::string> names;
+	for (const TableColumn &column : columns) names.push_back(column.name);
+
+	write_csv_rows(path, names, num_samples, [&](size_t sample) { return start_time + sample * sample_period; },
+		[&](size_t column, size_t sample) { return columns[column].values[sample]; });
+}
+
+template <typename T>
+	requires (std::is_same_v<T, float> || std::is_same_v<T, double>)
+void write_table(const fs::path &path, double start_time, double sample_period, std::span<const BasicTableColumn<T>> columns) {
+	const size_t num_samples = get_num_samples(columns);
+
+	std::vector<std::byte> header;
+	const std::byte *magic = reinterpret_cast<const std::byte *>(binary_table::magic);
+	header.insert(header.end(), magic, magic + sizeof(binary_table::magic));
+	put(header, binary_table::version);
+	put(header, static_cast<uint32_t>(sizeof(T)));
+	put(header, static_cast<uint64_t>(columns.size()));
+	put(header, static_cast<uint64_t>(num_samples));
+	put(header, start_time);
+	put(header, sample_period);
+
+	// filled in once the names are in
+	const size_t offset_position = header.size();
+	put(header, uint64_t(0));
+
+	for (const BasicTableColumn<T> &column : columns) {
+		put_string(header, column.name);
+		put_string(header, column.unit);
+	}
+
+	const size_t alignment = binary_table::data_alignment;
+	const uint64_t data_offset = (header.size() + alignment - 1) / alignment * alignment;
+	header.resize(data_offset);
+	std::memcpy(header.data() + offset_position, &data_offset, sizeof(data_offset));
+
+	std::FILE *file = std::fopen(path.string().c_str(), "wb");
+	if (!file) throw TableError("Failed to open output file: " + path.string());
+
+	bool written = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+	for (const BasicTableColumn<T> &column : columns) {
+		written = written && std::fwrite(column.values.data(), sizeof(T), num_samples, file) == num_samples;
+	}
+	written = std::fclose(file) == 0 && written;
+
+	if (!written) throw TableError("Failed to write the table " + path.string());
+}
+
+template void write_table<float>(const fs::path &, double, double, std::span<const BasicTableColumn<float>>);
+template void write_table<double>(const fs::path &, double, double, std::span<const BasicTableColumn<double>>);
+
+
+TableReader::TableReader(const fs::path &path) {
+	map(path);
+
+	try {
+		parse(path);
+	}
+	catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+TableReader::~TableReader() noexcept {
+	unmap();
+}
+
+#ifdef _WIN32
+void TableReader::map(const fs::path &path) {
+	file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		throw TableError("Failed to open the table " + path.string());
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		unmap();
+		throw TableError("Failed to read the table " + path.string());
+	}
+	size = static_cast<size_t>(file_size.QuadPart);
+
+	// an empty file can't be mapped, the parser reports it as truncated
+	if (size == 0) return;
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		unmap();
+		throw TableError("Failed to map the table " + path.string());
+	}
+	data = static_cast<const std::byte *>(view);
+}
+
+void TableReader::unmap() noexcept {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	data = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+}
+#else
+void TableReader::map(const fs::path &path) {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw TableError("Failed to open the table " + path.string());
+
+	struct stat status;
+	if (::fstat(fd, &status) != 0) {
+		::close(fd);
+		throw TableError("Failed to read the table " + path.string());
+	}
+	size = static_cast<size_t>(status.st_size);
+
+	// an empty file can't be mapped, the parser reports it as truncated
+	if (size > 0) {
+		void *view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED) {
+			::close(fd);
+			throw TableError("Failed to map the table " + path.string());
+		}
+		data = static_cast<const std::byte *>(view);
+	}
+
+	// the mapping stays valid without the descriptor
+	::close(fd);
+}
+
+void TableReader::unmap() noexcept {
+	if (data) ::munmap(const_cast<std::byte *>(data), size);
+	data = nullptr;
+}
+#endif
+
+void TableReader::parse(const fs::path &path) {
+	size_t position = 0;
+
+	auto get = [&]<typename T>(T &value) {
+		if (size - position < sizeof(T)) throw TableError("The table " + path.string() + " is truncated");
+		std::memcpy(&value, data + position, sizeof(T));
+		position += sizeof(T);
+	};
+	auto get_string = [&](std::string &text) {
+		uint32_t length;
+		get(length);
+		if (size - position < length) throw TableError("The table " + path.string() + " is truncated");
+		text.assign(reinterpret_cast<const char *>(data + position), length);
+		position += length;
+	};
+
+	char magic[sizeof(binary_table::magic)];
+	get(magic);
+	if (std::memcmp(magic, binary_table::magic, sizeof(magic)) != 0) {
+		throw TableError("The file " + path.string() + " is not a binary table");
+	}
+
+	uint32_t version;
+	get(version);
+	if (version != binary_table::version) {
+		throw TableError(std::format("The table {} has version {}, only version {} is supported", path.string(), version, binary_table::version));
+	}
+
+	uint64_t num_columns, samples, offset;
+	get(value_size);
+	get(num_columns);
+	get(samples);
+	get(start_time);
+	get(sample_period);
+	get(offset);
+
+	if (value_size != sizeof(float) && value_size != sizeof(double)) {
+		throw TableError(std::format("The table {} has values of {} bytes", path.string(), value_size));
+	}
+
+	// every column has at least its two lengths
+	if (num_columns > (size - position) / (2 * sizeof(uint32_t))) {
+		throw TableError("The table " + path.string() + " is truncated");
+	}
+
+	names.resize(num_columns);
+	units.resize(num_columns);
+	for (size_t c = 0; c < num_columns; ++c) {
+		get_string(names[c]);
+		get_string(units[c]);
+	}
+
+	num_samples = samples;
+	data_offset = offset;
+
+	if (data_offset < position || data_offset % binary_table::data_alignment != 0) {
+		throw TableError("The table " + path.string() + " has a wrong data offset");
+	}
+	if (data_offset > size || (num_columns > 0 && (num_samples > (size - data_offset) / value_size / num_columns))) {
+		throw TableError("The table " + path.string() + " is truncated");
+	}
+}
+
+const std::byte *TableReader::column_data(size_t column) const {
+	if (column >= names.size()) {
+		throw TableError(std::format("The table has no column {}, it has {}", column, names.size()));
+	}
+	return data + data_offset + column * num_samples * value_size;
+}
+
+double TableReader::get_value(size_t column, size_t sample) const {
+	const std::byte *value = column_data(column) + sample * value_size;
+
+	if (value_size == sizeof(double)) {
+		double result;
+		std::memcpy(&result, value, sizeof(result));
+		return result;
+	}
+
+	float result;
+	std::memcpy(&result, value, sizeof(result));
+	return result;
+}
+
+void TableReader::write_csv(const fs::path &path) const {
+	write_csv_rows(path, names, num_samples, [this](size_t sample) { return get_time(sample); },
+		[this](size_t column, size_t sample) { return get_value(column, sample); });
+}
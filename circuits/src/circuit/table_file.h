@@ -0,0 +1,125 @@
+#pragma once
+
+#include "scalar.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+
+class TableError : public std::runtime_error {
+public:
+	explicit TableError(const std::string &message) : std::runtime_error(message) {}
+};
+
+
+/* The binary table of the scopes (.slt), little endian:
+ *   char[8]  magic "SLTABLE\0"
+ *   u32      version
+ *   u32      value size, 4 for float and 8 for double
+ *   u64      column count
+ *   u64      sample count
+ *   f64      time of the first sample
+ *   f64      time between the samples
+ *   u64      offset of the data from the start of the file, a multiple of 64
+ *   then for every column its name and unit, each as a u32 length and the bytes
+ * The data are the columns one after another, every column the sample count of values, so a mapped file
+ * gives every column as an array. The times are not stored, the sample i is at start + i * period. */
+namespace binary_table {
+	inline constexpr char magic[8] = { 'S', 'L', 'T', 'A', 'B', 'L', 'E', '\0' };
+	inline constexpr uint32_t version = 1;
+	inline constexpr size_t data_alignment = 64;
+}
+
+enum class TableFormat {
+	// one CSV of all the scopes
+	csv,
+	// one binary table of all the scopes
+	binary
+};
+
+template <typename T>
+struct BasicTableColumn {
+	std::string name;
+	std::string unit;
+	std::span<const T> values;
+};
+
+using TableColumn = BasicTableColumn<scalar>;
+
+// writes every column with one bulk write, the columns must have the same length. throws TableError
+template <typename T>
+	requires (std::is_same_v<T, float> || std::is_same_v<T, double>)
+void write_table(const fs::path &path, double start_time, double sample_period, std::span<const BasicTableColumn<T>> columns);
+
+inline void write_table(const fs::path &path, scalar start_time, scalar sample_period, std::span<const TableColumn> columns) {
+	write_table<scalar>(path, start_time, sample_period, columns);
+}
+// the CSV with the time and a column for each column, the columns must have the same length. throws TableError
+void write_csv_table(const fs::path &path, scalar start_time, scalar sample_period, std::span<const TableColumn> columns);
+// a number of a CSV table, the same text as std::ostream with its default precision
+void append_csv_number(std::string &text, double value);
+
+
+// A memory mapped binary table, the columns are read straight from the file.
+class TableReader {
+private:
+	const std::byte *data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#endif
+
+	uint32_t value_size = 0;
+	size_t num_samples = 0;
+	double start_time = 0.0;
+	double sample_period = 0.0;
+	size_t data_offset = 0;
+	std::vector<std::string> names;
+	std::vector<std::string> units;
+
+	void map(const fs::path &path);
+	void unmap() noexcept;
+	void parse(const fs::path &path);
+
+	const std::byte *column_data(size_t column) const;
+
+public:
+	// throws TableError
+	explicit TableReader(const fs::path &path);
+	~TableReader() noexcept;
+
+	TableReader(const TableReader &) = delete;
+	TableReader &operator=(const TableReader &) = delete;
+
+	inline size_t get_num_columns() const noexcept { return names.size(); }
+	inline size_t get_num_samples() const noexcept { return num_samples; }
+	inline size_t get_value_size() const noexcept { return value_size; }
+	inline double get_start_time() const noexcept { return start_time; }
+	inline double get_sample_period() const noexcept { return sample_period; }
+	inline double get_time(size_t sample) const noexcept { return start_time + sample * sample_period; }
+	inline const std::string &get_name(size_t column) const { return names[column]; }
+	inline const std::string &get_unit(size_t column) const { return units[column]; }
+
+	// the column as stored, T must have the value size. throws TableError
+	template <typename T>
+		requires (std::is_same_v<T, float> || std::is_same_v<T, double>)
+	std::span<const T> get_column(size_t column) const {
+		if (sizeof(T) != value_size) throw TableError("The table stores another type of values");
+		return { reinterpret_cast<const T *>(column_data(column)), num_samples };
+	}
+
+	// of any value size
+	double get_value(size_t column, size_t sample) const;
+
+	// One CSV with the time and a column for each column of the table. throws TableError
+	void write_csv(const fs::path &path) const;
+};
@@ -0,0 +1,207 @@
+#include "task_scheduler.h"
+
+#include "scalar.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+void TaskDeque::push(size_t task) noexcept {
+	const std::ptrdiff_t b = bottom.load(std::memory_order_relaxed);
+	tasks[static_cast<size_t>(b)].store(task, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+bool TaskDeque::pop(size_t &task) noexcept {
+	const std::ptrdiff_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::ptrdiff_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	task = tasks[static_cast<size_t>(b)].load(std::memory_order_relaxed);
+	if (t < b) return true;
+
+	// the last task, a thief may be taking it too
+	const bool taken = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return taken;
+}
+
+bool TaskDeque::steal(size_t &task) noexcept {
+	std::ptrdiff_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const std::ptrdiff_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b) return false;
+
+	task = tasks[static_cast<size_t>(t)].load(std::memory_order_relaxed);
+	return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+
+std::optional<std::vector<size_t>> TaskScheduler::topological_order(const std::vector<std::vector<size_t>> &successors) {
+	std::vector<size_t> num_predecessors(successors.size(), 0);
+	for (const std::vector<size_t> &next : successors) {
+		for (size_t s : next) ++num_predecessors[s];
+	}
+
+	std::vector<size_t> order;
+	order.reserve(successors.size());
+	for (size_t i = 0; i < successors.size(); ++i) {
+		if (num_predecessors[i] == 0) order.push_back(i);
+	}
+
+	for (size_t k = 0; k < order.size(); ++k) {
+		for (size_t s : successors[order[k]]) {
+			if (--num_predecessors[s] == 0) order.push_back(s);
+		}
+	}
+
+	// the tasks on a cycle never lose all their predecessors
+	if (order.size() != successors.size()) return std::nullopt;
+	return order;
+}
+
+TaskScheduler::TaskScheduler(size_t num_threads, std::vector<std::vector<size_t>> successors, Task task) :
+	num_tasks(successors.size()),
+	task(std::move(task)),
+	successors(std::move(successors)),
+	num_predecessors(num_tasks, 0),
+	costs(num_tasks, 0.0),
+	last_durations(num_tasks, 0.0),
+	ranks(num_tasks, 0.0),
+	waiting(num_tasks) {
+	for (const std::vector<size_t> &next : this->successors) {
+		for (size_t s : next) {
+			if (s >= num_tasks) throw std::runtime_error("A successor of a task is out of the task graph");
+			++num_predecessors[s];
+		}
+	}
+
+	std::optional<std::vector<size_t>> sorted = topological_order(this->successors);
+	if (!sorted) throw std::runtime_error("The task graph has a cycle");
+	order = std::move(*sorted);
+
+	for (size_t i = 0; i < num_tasks; ++i) {
+		if (num_predecessors[i] == 0) roots.push_back(i);
+	}
+
+	num_threads = std::max<size_t>(num_threads, 1);
+	for (size_t w = 0; w < num_threads; ++w) {
+		deques.push_back(std::make_unique<TaskDeque>(std::max<size_t>(num_tasks, 1)));
+	}
+
+	if (num_threads > 1) {
+		barrier = std::make_unique<std::barrier<>>(static_cast<std::ptrdiff_t>(num_threads));
+		workers.reserve(num_threads - 1);
+		for (size_t w = 1; w < num_threads; ++w) {
+			workers.emplace_back([this, w](std::stop_token stop) { work(stop, w); });
+		}
+	}
+}
+
+TaskScheduler::~TaskScheduler() noexcept {
+	if (workers.empty()) return;
+
+	for (std::jthread &worker : workers) worker.request_stop();
+	// the workers wait for the next run, they see the stop and leave
+	barrier->arrive_and_wait();
+	workers.clear();
+}
+
+void TaskScheduler::work(std::stop_token stop, size_t worker) {
+	while (true) {
+		barrier->arrive_and_wait();
+		if (stop.stop_requested()) return;
+
+		run_worker(worker);
+		barrier->arrive_and_wait();
+	}
+}
+
+void TaskScheduler::run_worker(size_t worker) noexcept {
+	while (remaining.load(std::memory_order_acquire) > 0) {
+		size_t next;
+		if (deques[worker]->pop(next) || steal(worker, next)) {
+			execute(worker, next);
+		}
+		else {
+			// the ready tasks run elsewhere, the rest waits for them
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool TaskScheduler::steal(size_t worker, size_t &task) noexcept {
+	for (size_t k = 1; k < deques.size(); ++k) {
+		if (deques[(worker + k) % deques.size()]->steal(task)) return true;
+	}
+	return false;
+}
+
+void TaskScheduler::execute(size_t worker, size_t id) noexcept {
+	const auto start = std::chrono::steady_clock::now();
+	task(id);
+	last_durations[id] = std::chrono::duration<scalar>(std::chrono::steady_clock::now() - start).count();
+
+	// the highest rank goes last, so the worker pops it first
+	for (size_t s : successors[id]) {
+		if (waiting[s].fetch_sub(1, std::memory_order_acq_rel) == 1) deques[worker]->push(s);
+	}
+
+	remaining.fetch_sub(1, std::memory_order_release);
+}
+
+void TaskScheduler::update_ranks() noexcept {
+	for (size_t i = 0; i < num_tasks; ++i) {
+		// the first run sets the average, the later ones move it by an eighth
+		costs[i] = costs[i] == 0.0 ? last_durations[i] : costs[i] + 0.125 * (last_durations[i] - costs[i]);
+	}
+
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		scalar longest = 0.0;
+		for (size_t s : successors[*it]) longest = std::max(longest, ranks[s]);
+		ranks[*it] = costs[*it] + longest;
+	}
+
+	for (std::vector<size_t> &next : successors) {
+		std::sort(next.begin(), next.end(), [this](size_t a, size_t b) { return ranks[a] < ranks[b]; });
+	}
+	std::sort(roots.begin(), roots.end(), [this](size_t a, size_t b) { return ranks[a] > ranks[b]; });
+}
+
+void TaskScheduler::run() noexcept {
+	if (num_tasks == 0) return;
+
+	for (size_t i = 0; i < num_tasks; ++i) {
+		waiting[i].store(num_predecessors[i], std::memory_order_relaxed);
+	}
+	for (const std::unique_ptr<TaskDeque> &deque : deques) deque->clear();
+	remaining.store(num_tasks, std::memory_order_relaxed);
+
+	// the roots are dealt to the workers by the rank, every worker gets its highest first
+	for (size_t k = roots.size(); k-- > 0;) {
+		deques[k % deques.size()]->push(roots[k]);
+	}
+
+	if (workers.empty()) {
+		run_worker(0);
+	}
+	else {
+		barrier->arrive_and_wait();
+		run_worker(0);
+		barrier->arrive_and_wait();
+	}
+
+	update_ranks();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "scalar.h"
+#include <atomic>
+#include <barrier>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+
+/* The ready tasks of one worker, a Chase-Lev deque. The owner pushes and pops at the bottom, the other
+ * workers steal from the top. A run pushes every task once, so a capacity of the task count never wraps
+ * and the deque never grows. */
+class TaskDeque {
+private:
+	std::vector<std::atomic<size_t>> tasks;
+
+	// on separate cache lines, the owner moves the bottom and the thieves the top
+	alignas(64) std::atomic<std::ptrdiff_t> top{ 0 };
+	alignas(64) std::atomic<std::ptrdiff_t> bottom{ 0 };
+
+public:
+	explicit TaskDeque(size_t capacity) : tasks(capacity) {}
+
+	// only between the runs
+	inline void clear() noexcept {
+		top.store(0, std::memory_order_relaxed);
+		bottom.store(0, std::memory_order_relaxed);
+	}
+
+	// the owner
+	void push(size_t task) noexcept;
+	bool pop(size_t &task) noexcept;
+	// the other workers
+	bool steal(size_t &task) noexcept;
+};
+
+
+/* Runs a fixed graph of tasks on a pool of threads, every task once per run and after all its predecessors.
+ * The calling thread works too. Every worker runs the tasks it made ready itself and steals from the others
+ * when it has none. The scheduler times every task and starts the ready ones with the longest chain of work
+ * still behind them first, so the expensive chains spread over the workers as the costs change. */
+class TaskScheduler {
+public:
+	using Task = std::function<void(size_t)>;
+
+private:
+	size_t num_tasks;
+	Task task;
+
+	// sorted by the rank, the highest last
+	std::vector<std::vector<size_t>> successors;
+	std::vector<size_t> num_predecessors;
+	// the tasks without predecessors, by the rank, the highest first
+	std::vector<size_t> roots;
+	std::vector<size_t> order;
+
+	// seconds of a run of the task, an exponential moving average
+	std::vector<scalar> costs;
+	std::vector<scalar> last_durations;
+	// the cost of the task and of the most expensive chain of its successors
+	std::vector<scalar> ranks;
+
+	// predecessors of the task not yet done in this run
+	std::vector<std::atomic<size_t>> waiting;
+	std::atomic<size_t> remaining{ 0 };
+
+	// the worker 0 is the calling thread
+	std::vector<std::unique_ptr<TaskDeque>> deques;
+	std::vector<std::jthread> workers;
+	// every run passes it twice, once at its start and once at its end
+	std::unique_ptr<std::barrier<>> barrier;
+
+	void work(std::stop_token stop, size_t worker);
+	void run_worker(size_t worker) noexcept;
+	bool steal(size_t worker, size_t &task) noexcept;
+	void execute(size_t worker, size_t task) noexcept;
+	void update_ranks() noexcept;
+
+public:
+	// the order in which the tasks can run one by one, nullopt if the graph has a cycle
+	static std::optional<std::vector<size_t>> topological_order(const std::vector<std::vector<size_t>> &successors);
+
+	// successors[i] are the tasks that run after the task i, task(i) runs it. throws std::runtime_error on a cycle
+	TaskScheduler(size_t num_threads, std::vector<std::vector<size_t>> successors, Task task);
+	~TaskScheduler() noexcept;
+
+	TaskScheduler(const TaskScheduler &) = delete;
+	TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+	// Runs every task once and waits for them. Allocates nothing.
+	void run() noexcept;
+
+	inline size_t get_num_threads() const noexcept { return deques.size(); }
+	// seconds, valid between the runs
+	inline scalar get_cost(size_t task) const noexcept { return costs[task]; }
+};
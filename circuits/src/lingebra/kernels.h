@@ -0,0 +1,347 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define LINGEBRA_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows the AVX intrinsics in any function, gcc and clang need them enabled per function
+#if defined(LINGEBRA_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LINGEBRA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define LINGEBRA_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define LINGEBRA_TARGET_AVX2
+#define LINGEBRA_TARGET_AVX512
+#endif
+
+
+namespace lingebra {
+	// Allocator for the SIMD friendly buffers, every allocation starts on the given alignment
+	template <class T, size_t Align = 64>
+	struct AlignedAllocator {
+		using value_type = T;
+
+		template <class U>
+		struct rebind { using other = AlignedAllocator<U, Align>; };
+
+		constexpr AlignedAllocator() noexcept = default;
+		template <class U>
+		constexpr AlignedAllocator(const AlignedAllocator<U, Align> &) noexcept {}
+
+		T *allocate(size_t n) {
+			if (n > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+			return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{ Align }));
+		}
+
+		void deallocate(T *p, size_t) noexcept {
+			::operator delete(p, std::align_val_t{ Align });
+		}
+
+		template <class U>
+		constexpr bool operator==(const AlignedAllocator<U, Align> &) const noexcept { return true; }
+	};
+
+
+	/* Kernels of the dense operations. The float and double versions pick AVX-512, AVX2 or the
+	 * plain loop once at runtime by the CPU, every other field uses the plain loop. */
+	namespace kernels {
+		enum class Isa {
+			scalar,
+			avx2,
+			avx512
+		};
+
+		inline Isa detect_isa() noexcept {
+#if defined(LINGEBRA_X86) && defined(_MSC_VER)
+			int regs[4];
+			__cpuid(regs, 0);
+			const int max_leaf = regs[0];
+			if (max_leaf < 7) return Isa::scalar;
+
+			__cpuid(regs, 1);
+			const bool osxsave = (regs[2] & (1 << 27)) != 0;
+			const bool avx = (regs[2] & (1 << 28)) != 0;
+			const bool fma = (regs[2] & (1 << 12)) != 0;
+			if (!osxsave || !avx || !fma) return Isa::scalar;
+
+			// the OS must save the ymm (and zmm) registers
+			const unsigned long long xcr0 = _xgetbv(0);
+			if ((xcr0 & 0x6) != 0x6) return Isa::scalar;
+
+			__cpuidex(regs, 7, 0);
+			const bool avx2 = (regs[1] & (1 << 5)) != 0;
+			const bool avx512f = (regs[1] & (1 << 16)) != 0;
+
+			if (avx512f && (xcr0 & 0xe6) == 0xe6) return Isa::avx512;
+			if (avx2) return Isa::avx2;
+			return Isa::scalar;
+#elif defined(LINGEBRA_X86)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f")) return Isa::avx512;
+			if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return Isa::avx2;
+			return Isa::scalar;
+#else
+			return Isa::scalar;
+#endif
+		}
+
+		// detected once
+		inline Isa active_isa() noexcept {
+			static const Isa isa = detect_isa();
+			return isa;
+		}
+
+
+		// plain loops, the fallback and the only version for the non floating point fields
+
+		// y[i] -= a * x[i]
+		template <class F>
+		constexpr void sub_scaled_generic(F *y, const F *x, const F &a, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				y[i] -= x[i] * a;
+			}
+		}
+
+		// y[i] += a * x[i]
+		template <class F>
+		constexpr void add_scaled_generic(F *y, const F *x, const F &a, size_t n) {
+			for (size_t i = 0; i < n; ++i) {
+				y[i] += x[i] * a;
+			}
+		}
+
+		template <class F>
+		constexpr F dot_generic(const F *x, const F *y, size_t n, const F &zero) {
+			F sum = zero;
+			for (size_t i = 0; i < n; ++i) {
+				sum += x[i] * y[i];
+			}
+			return sum;
+		}
+
+
+#ifdef LINGEBRA_X86
+		// AVX2 + FMA
+
+		LINGEBRA_TARGET_AVX2 inline void sub_scaled_avx2(double *y, const double *x, double a, size_t n) {
+			const __m256d va = _mm256_set1_pd(a);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				_mm256_storeu_pd(y + i, _mm256_fnmadd_pd(_mm256_loadu_pd(x + i), va, _mm256_loadu_pd(y + i)));
+			}
+			for (; i < n; ++i) y[i] -= x[i] * a;
+		}
+
+		LINGEBRA_TARGET_AVX2 inline void sub_scaled_avx2(float *y, const float *x, float a, size_t n) {
+			const __m256 va = _mm256_set1_ps(a);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_ps(y + i, _mm256_fnmadd_ps(_mm256_loadu_ps(x + i), va, _mm256_loadu_ps(y + i)));
+			}
+			for (; i < n; ++i) y[i] -= x[i] * a;
+		}
+
+		LINGEBRA_TARGET_AVX2 inline void add_scaled_avx2(double *y, const double *x, double a, size_t n) {
+			const __m256d va = _mm256_set1_pd(a);
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				_mm256_storeu_pd(y + i, _mm256_fmadd_pd(_mm256_loadu_pd(x + i), va, _mm256_loadu_pd(y + i)));
+			}
+			for (; i < n; ++i) y[i] += x[i] * a;
+		}
+
+		LINGEBRA_TARGET_AVX2 inline void add_scaled_avx2(float *y, const float *x, float a, size_t n) {
+			const __m256 va = _mm256_set1_ps(a);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm256_storeu_ps(y + i, _mm256_fmadd_ps(_mm256_loadu_ps(x + i), va, _mm256_loadu_ps(y + i)));
+			}
+			for (; i < n; ++i) y[i] += x[i] * a;
+		}
+
+		LINGEBRA_TARGET_AVX2 inline double dot_avx2(const double *x, const double *y, size_t n) {
+			__m256d acc0 = _mm256_setzero_pd();
+			__m256d acc1 = _mm256_setzero_pd();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), acc0);
+				acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), acc1);
+			}
+			for (; i + 4 <= n; i += 4) {
+				acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), acc0);
+			}
+
+			alignas(32) double lanes[4];
+			_mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+			double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+			for (; i < n; ++i) sum += x[i] * y[i];
+			return sum;
+		}
+
+		LINGEBRA_TARGET_AVX2 inline float dot_avx2(const float *x, const float *y, size_t n) {
+			__m256 acc0 = _mm256_setzero_ps();
+			__m256 acc1 = _mm256_setzero_ps();
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc0);
+				acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), acc1);
+			}
+			for (; i + 8 <= n; i += 8) {
+				acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), acc0);
+			}
+
+			alignas(32) float lanes[8];
+			_mm256_store_ps(lanes, _mm256_add_ps(acc0, acc1));
+			float sum = 0.0f;
+			for (float lane : lanes) sum += lane;
+
+			for (; i < n; ++i) sum += x[i] * y[i];
+			return sum;
+		}
+
+
+		// AVX-512, the tails are done with masked loads
+
+		LINGEBRA_TARGET_AVX512 inline void sub_scaled_avx512(double *y, const double *x, double a, size_t n) {
+			const __m512d va = _mm512_set1_pd(a);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm512_storeu_pd(y + i, _mm512_fnmadd_pd(_mm512_loadu_pd(x + i), va, _mm512_loadu_pd(y + i)));
+			}
+			if (i < n) {
+				const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+				const __m512d vx = _mm512_maskz_loadu_pd(mask, x + i);
+				const __m512d vy = _mm512_maskz_loadu_pd(mask, y + i);
+				_mm512_mask_storeu_pd(y + i, mask, _mm512_fnmadd_pd(vx, va, vy));
+			}
+		}
+
+		LINGEBRA_TARGET_AVX512 inline void sub_scaled_avx512(float *y, const float *x, float a, size_t n) {
+			const __m512 va = _mm512_set1_ps(a);
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				_mm512_storeu_ps(y + i, _mm512_fnmadd_ps(_mm512_loadu_ps(x + i), va, _mm512_loadu_ps(y + i)));
+			}
+			if (i < n) {
+				const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+				const __m512 vx = _mm512_maskz_loadu_ps(mask, x + i);
+				const __m512 vy = _mm512_maskz_loadu_ps(mask, y + i);
+				_mm512_mask_storeu_ps(y + i, mask, _mm512_fnmadd_ps(vx, va, vy));
+			}
+		}
+
+		LINGEBRA_TARGET_AVX512 inline void add_scaled_avx512(double *y, const double *x, double a, size_t n) {
+			const __m512d va = _mm512_set1_pd(a);
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				_mm512_storeu_pd(y + i, _mm512_fmadd_pd(_mm512_loadu_pd(x + i), va, _mm512_loadu_pd(y + i)));
+			}
+			if (i < n) {
+				const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+				const __m512d vx = _mm512_maskz_loadu_pd(mask, x + i);
+				const __m512d vy = _mm512_maskz_loadu_pd(mask, y + i);
+				_mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(vx, va, vy));
+			}
+		}
+
+		LINGEBRA_TARGET_AVX512 inline void add_scaled_avx512(float *y, const float *x, float a, size_t n) {
+			const __m512 va = _mm512_set1_ps(a);
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				_mm512_storeu_ps(y + i, _mm512_fmadd_ps(_mm512_loadu_ps(x + i), va, _mm512_loadu_ps(y + i)));
+			}
+			if (i < n) {
+				const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+				const __m512 vx = _mm512_maskz_loadu_ps(mask, x + i);
+				const __m512 vy = _mm512_maskz_loadu_ps(mask, y + i);
+				_mm512_mask_storeu_ps(y + i, mask, _mm512_fmadd_ps(vx, va, vy));
+			}
+		}
+
+		LINGEBRA_TARGET_AVX512 inline double dot_avx512(const double *x, const double *y, size_t n) {
+			__m512d acc = _mm512_setzero_pd();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				acc = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), acc);
+			}
+			if (i < n) {
+				const __mmask8 mask = static_cast<__mmask8>((1u << (n - i)) - 1);
+				acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i), acc);
+			}
+			return _mm512_reduce_add_pd(acc);
+		}
+
+		LINGEBRA_TARGET_AVX512 inline float dot_avx512(const float *x, const float *y, size_t n) {
+			__m512 acc = _mm512_setzero_ps();
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				acc = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), acc);
+			}
+			if (i < n) {
+				const __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+				acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, x + i), _mm512_maskz_loadu_ps(mask, y + i), acc);
+			}
+			return _mm512_reduce_add_ps(acc);
+		}
+#endif // LINGEBRA_X86
+
+
+		template <class F>
+		concept simd_scalar = std::same_as<F, float> || std::same_as<F, double>;
+
+		// y[i] -= a * x[i] for i < n, the row update of the elimination
+		template <class F>
+		void sub_scaled(F *y, const F *x, const F &a, size_t n) {
+#ifdef LINGEBRA_X86
+			if constexpr (simd_scalar<F>) {
+				switch (active_isa()) {
+				case Isa::avx512: sub_scaled_avx512(y, x, a, n); return;
+				case Isa::avx2: sub_scaled_avx2(y, x, a, n); return;
+				default: break;
+				}
+			}
+#endif
+			sub_scaled_generic(y, x, a, n);
+		}
+
+		// y[i] += a * x[i] for i < n
+		template <class F>
+		void add_scaled(F *y, const F *x, const F &a, size_t n) {
+#ifdef LINGEBRA_X86
+			if constexpr (simd_scalar<F>) {
+				switch (active_isa()) {
+				case Isa::avx512: add_scaled_avx512(y, x, a, n); return;
+				case Isa::avx2: add_scaled_avx2(y, x, a, n); return;
+				default: break;
+				}
+			}
+#endif
+			add_scaled_generic(y, x, a, n);
+		}
+
+		// sum of x[i] * y[i] for i < n
+		template <class F>
+		F dot(const F *x, const F *y, size_t n, const F &zero) {
+#ifdef LINGEBRA_X86
+			if constexpr (simd_scalar<F>) {
+				switch (active_isa()) {
+				case Isa::avx512: return dot_avx512(x, y, n);
+				case Isa::avx2: return dot_avx2(x, y, n);
+				default: break;
+				}
+			}
+#endif
+			return dot_generic(x, y, n, zero);
+		}
+	}
+}
@@ -1,21 +1,29 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <compare>
 #include <concepts>
 #include <cstdint>
 #include <format>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <queue>
 #include <random>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "kernels.h"
+
 
 namespace lingebra {
 	// generic abs
@@ -166,6 +174,109 @@ namespace lingebra {
 	template <class T> inline constexpr bool is_ModInt_v = is_ModInt<T>::value;
 	template <class T> concept ModIntLike = is_ModInt_v<T>;
 
+
+	// lanes
+
+	/* N independent values computed together, the loops over the lanes compile to SIMD instructions.
+	 * Lanes is a field, so the sparse LU of Lanes<F, N> solves N systems of the same structure at once.
+	 * The pivots must be in the same row in every lane, so a value is zero when any of its lanes is
+	 * and the values compare by their smallest lane: the pivoting then prefers the row that is the
+	 * farthest from a zero pivot in its worst lane. */
+	template <std::floating_point F, size_t N>
+		requires (N > 0 && (N & (N - 1)) == 0)
+	class Lanes {
+	public:
+		using lane_type = F;
+
+	private:
+		alignas(std::min<size_t>(N * sizeof(F), 64)) std::array<F, N> lanes;
+
+	public:
+		constexpr Lanes() noexcept : lanes{} {}
+		// every lane set to the value
+		constexpr Lanes(F value) noexcept {
+			lanes.fill(value);
+		}
+
+		static constexpr size_t size() noexcept { return N; }
+
+		constexpr F &operator[](size_t i) noexcept { return lanes[i]; }
+		constexpr const F &operator[](size_t i) const noexcept { return lanes[i]; }
+
+		constexpr Lanes &operator+=(const Lanes &other) noexcept {
+			for (size_t i = 0; i < N; ++i) lanes[i] += other.lanes[i];
+			return *this;
+		}
+		constexpr Lanes &operator-=(const Lanes &other) noexcept {
+			for (size_t i = 0; i < N; ++i) lanes[i] -= other.lanes[i];
+			return *this;
+		}
+		constexpr Lanes &operator*=(const Lanes &other) noexcept {
+			for (size_t i = 0; i < N; ++i) lanes[i] *= other.lanes[i];
+			return *this;
+		}
+		constexpr Lanes &operator/=(const Lanes &other) noexcept {
+			for (size_t i = 0; i < N; ++i) lanes[i] /= other.lanes[i];
+			return *this;
+		}
+
+		constexpr Lanes operator+(const Lanes &other) const noexcept {
+			Lanes temp = *this;
+			temp += other;
+			return temp;
+		}
+		constexpr Lanes operator-(const Lanes &other) const noexcept {
+			Lanes temp = *this;
+			temp -= other;
+			return temp;
+		}
+		constexpr Lanes operator*(const Lanes &other) const noexcept {
+			Lanes temp = *this;
+			temp *= other;
+			return temp;
+		}
+		constexpr Lanes operator/(const Lanes &other) const noexcept {
+			Lanes temp = *this;
+			temp /= other;
+			return temp;
+		}
+		constexpr Lanes operator-() const noexcept {
+			Lanes temp;
+			for (size_t i = 0; i < N; ++i) temp.lanes[i] = -lanes[i];
+			return temp;
+		}
+
+		constexpr Lanes abs() const noexcept {
+			Lanes temp;
+			for (size_t i = 0; i < N; ++i) temp.lanes[i] = lanes[i] < 0 ? -lanes[i] : lanes[i];
+			return temp;
+		}
+
+		constexpr F min() const noexcept {
+			F result = lanes[0];
+			for (size_t i = 1; i < N; ++i) result = std::min(result, lanes[i]);
+			return result;
+		}
+
+		// zero when any lane is, like the floating point is_zero
+		constexpr bool is_zero() const noexcept {
+			for (size_t i = 0; i < N; ++i) {
+				if ((lanes[i] < 0 ? -lanes[i] : lanes[i]) < std::numeric_limits<F>::epsilon()) return true;
+			}
+			return false;
+		}
+
+		friend constexpr bool operator==(const Lanes &, const Lanes &) = default;
+		// by the smallest lane
+		friend constexpr std::partial_ordering operator<=>(const Lanes &a, const Lanes &b) noexcept {
+			return a.min() <=> b.min();
+		}
+	};
+
+	template <class T> struct is_Lanes : std::false_type {};
+	template <std::floating_point F, size_t N> struct is_Lanes<Lanes<F, N>> : std::true_type {};
+	template <class T> inline constexpr bool is_Lanes_v = is_Lanes<T>::value;
+
 	// "field" concept
 
 	template <class T>
@@ -301,6 +412,14 @@ namespace lingebra {
 			return data.size();
 		}
 
+		constexpr std::span<F> values() noexcept {
+			return data;
+		}
+
+		constexpr std::span<const F> values() const noexcept {
+			return data;
+		}
+
 		constexpr void swap_values(size_t a, size_t b) noexcept(std::is_nothrow_swappable_v<F>) {
 			using std::swap;
 			swap(data[a], data[b]);
@@ -389,45 +508,48 @@ namespace lingebra {
 	};
 
 
-	// A dense matrix
+	// A dense matrix, stored row-major in one aligned buffer. The rows are padded to a multiple
+	// of the cache line for the arithmetic types, row i starts at data[i * row_stride].
 	template <field F>
 	class Matrix {
 	public:
 		using value_type = F;
 
 	private:
-		std::vector<std::vector<F>> data;
-		size_t num_rows, num_cols;
+		std::vector<F, AlignedAllocator<F>> data;
+		size_t num_rows, num_cols, row_stride;
 
 		static constexpr F zero = make_zero<F>();
 
-	public:
-		constexpr Matrix(const std::vector<std::vector<F>> &data) : data(data) {
-			num_rows = data.size();
-			if (num_rows != 0) {
-				num_cols = data[0].size();
+		static constexpr size_t padded_stride(size_t n) noexcept {
+			if constexpr (std::is_arithmetic_v<F> && 64 % sizeof(F) == 0) {
+				constexpr size_t lanes = 64 / sizeof(F);
+				return (n + lanes - 1) / lanes * lanes;
 			}
 			else {
-				num_cols = 0;
+				return n;
 			}
 		}
-		constexpr Matrix() noexcept : num_rows(0), num_cols(0) {}
-		constexpr Matrix(size_t m, size_t n, const F &value) : data(m, std::vector<F>(n, value)), num_rows(m), num_cols(n) {}
-		constexpr Matrix(size_t m, size_t n) : Matrix(m, n, zero) {}
-		constexpr Matrix(std::initializer_list<std::initializer_list<F>> list) : num_cols(0) {
-			num_rows = list.size();
-			bool num_cols_set = false;
-			for (const std::initializer_list<F> &row : list) {
-				data.push_back(row);
-				if (!num_cols_set) {
-					num_cols = row.size();
-					num_cols_set = true;
+
+	public:
+		constexpr Matrix(const std::vector<std::vector<F>> &rows) : Matrix(rows.size(), rows.empty() ? 0 : rows[0].size()) {
+			for (size_t i = 0; i < num_rows; ++i) {
+				if (rows[i].size() != num_cols) {
+					throw std::runtime_error("All rows must be of the same lenght!");
 				}
-				else {
-					if (row.size() != num_cols) {
-						throw std::runtime_error("All rows must be of the same lenght!");
-					}
+				std::copy(rows[i].begin(), rows[i].end(), row(i).begin());
+			}
+		}
+		constexpr Matrix() noexcept : num_rows(0), num_cols(0), row_stride(0) {}
+		constexpr Matrix(size_t m, size_t n, const F &value) : data(m * padded_stride(n), value), num_rows(m), num_cols(n), row_stride(padded_stride(n)) {}
+		constexpr Matrix(size_t m, size_t n) : Matrix(m, n, zero) {}
+		constexpr Matrix(std::initializer_list<std::initializer_list<F>> list) : Matrix(list.size(), list.size() == 0 ? 0 : list.begin()->size()) {
+			size_t i = 0;
+			for (const std::initializer_list<F> &r : list) {
+				if (r.size() != num_cols) {
+					throw std::runtime_error("All rows must be of the same lenght!");
 				}
+				std::copy(r.begin(), r.end(), row(i++).begin());
 			}
 		}
 
@@ -459,23 +581,25 @@ namespace lingebra {
 		constexpr void assign(size_t m, size_t n, const F &value = zero) {
 			num_rows = m;
 			num_cols = n;
-			data.assign(m, std::vector<F>(n, value));
+			row_stride = padded_stride(n);
+			data.assign(m * row_stride, value);
 		}
 
 		constexpr F &operator()(size_t row, size_t col) noexcept {
-			return data[row][col];
+			return data[row * row_stride + col];
 		}
 
 		constexpr const F &operator()(size_t row, size_t col) const noexcept {
-			return data[row][col];
+			return data[row * row_stride + col];
 		}
 
-		constexpr std::vector<std::vector<F>> &rows() noexcept {
-			return data;
+		// the num_cols values of the row i, contiguous
+		constexpr std::span<F> row(size_t i) noexcept {
+			return std::span<F>(data.data() + i * row_stride, num_cols);
 		}
 
-		constexpr const std::vector<std::vector<F>> &rows() const noexcept {
-			return data;
+		constexpr std::span<const F> row(size_t i) const noexcept {
+			return std::span<const F>(data.data() + i * row_stride, num_cols);
 		}
 
 		constexpr size_t m() const noexcept {
@@ -486,11 +610,16 @@ namespace lingebra {
 			return num_cols;
 		}
 
+		// distance between the starts of two neighbouring rows
+		constexpr size_t stride() const noexcept {
+			return row_stride;
+		}
+
 		constexpr std::string repr() const {
 			size_t max_length = 0;
 			for (size_t i = 0; i < num_rows; ++i) {
 				for (size_t j = 0; j < num_cols; ++j) {
-					auto len = std::to_string(data[i][j]).length();
+					auto len = std::to_string((*this)(i, j)).length();
 					max_length = std::max(len, max_length);
 				}
 			}
@@ -503,10 +632,10 @@ namespace lingebra {
 					ss << (j == 0 ? "[" : " ");
 
 					if constexpr (std::floating_point<F>) {
-						ss << std::format("{:> {}.3f}", data[i][j], max_length);
+						ss << std::format("{:> {}.3f}", (*this)(i, j), max_length);
 					}
 					else {
-						ss << std::format("{:> {}}", data[i][j], max_length);
+						ss << std::format("{:> {}}", (*this)(i, j), max_length);
 					}
 				}
 
@@ -518,9 +647,9 @@ namespace lingebra {
 			return ss.str();
 		}
 
-		constexpr void swap_rows(size_t a, size_t b) noexcept(std::is_nothrow_swappable_v<std::vector<F>>) {
-			using std::swap;
-			swap(data[a], data[b]);
+		constexpr void swap_rows(size_t a, size_t b) noexcept(std::is_nothrow_swappable_v<F>) {
+			if (a == b) return;
+			std::swap_ranges(row(a).begin(), row(a).end(), row(b).begin());
 		}
 
 		constexpr bool is_square() const noexcept {
@@ -528,7 +657,13 @@ namespace lingebra {
 		}
 
 		constexpr bool operator==(const Matrix &other) const {
-			return data == other.data;
+			if (num_rows != other.num_rows || num_cols != other.num_cols) return false;
+
+			for (size_t i = 0; i < num_rows; ++i) {
+				if (!std::ranges::equal(row(i), other.row(i))) return false;
+			}
+
+			return true;
 		}
 
 		constexpr Matrix &operator+=(const Matrix &other) {
@@ -537,9 +672,7 @@ namespace lingebra {
 			}
 
 			for (size_t i = 0; i < num_rows; ++i) {
-				for (size_t j = 0; j < num_cols; ++j) {
-					data[i][j] += other(i, j);
-				}
+				kernels::add_scaled(row(i).data(), other.row(i).data(), make_one<F>(), num_cols);
 			}
 
 			return *this;
@@ -551,6 +684,7 @@ namespace lingebra {
 			return result;
 		}
 
+		// i-k-j order, every step adds a scaled row of other to a row of the result
 		constexpr Matrix operator*(const Matrix &other) const {
 			if (num_cols != other.num_rows) {
 				throw std::runtime_error("Uncompatible matrices for matrix product");
@@ -559,14 +693,10 @@ namespace lingebra {
 			Matrix result(num_rows, other.num_cols);
 
 			for (size_t i = 0; i < num_rows; ++i) {
-				for (size_t j = 0; j < other.num_cols; ++j) {
-					F sum = make_zero<F>();
-
-					for (size_t k = 0; k < num_cols; ++k) {
-						sum += (*this)(i, k) * other(k, j);
-					}
+				F *result_row = result.row(i).data();
 
-					result(i, j) = sum;
+				for (size_t k = 0; k < num_cols; ++k) {
+					kernels::add_scaled(result_row, other.row(k).data(), (*this)(i, k), other.num_cols);
 				}
 			}
 
@@ -575,17 +705,13 @@ namespace lingebra {
 
 		constexpr Matrix &operator*=(const F &scalar) {
 			for (size_t i = 0; i < num_rows; ++i) {
-				for (size_t j = 0; j < num_cols; ++j) {
-					(*this)(i, j) *= scalar;
-				}
+				for (F &x : row(i)) x *= scalar;
 			}
 			return *this;
 		}
 		constexpr Matrix &operator/=(const F &scalar) {
 			for (size_t i = 0; i < num_rows; ++i) {
-				for (size_t j = 0; j < num_cols; ++j) {
-					(*this)(i, j) /= scalar;
-				}
+				for (F &x : row(i)) x /= scalar;
 			}
 			return *this;
 		}
@@ -616,11 +742,7 @@ namespace lingebra {
 		Vector<F> result(matrix.m());
 
 		for (size_t i = 0; i < matrix.m(); ++i) {
-			F sum = make_zero<F>();
-			for (size_t j = 0; j < matrix.n(); ++j) {
-				sum += matrix(i, j) * vector[j];
-			}
-			result[i] = sum;
+			result[i] = kernels::dot(matrix.row(i).data(), vector.values().data(), matrix.n(), make_zero<F>());
 		}
 
 		return result;
@@ -634,12 +756,9 @@ namespace lingebra {
 
 		Vector<F> result(matrix.n());
 
-		for (size_t i = 0; i < matrix.n(); ++i) {
-			F sum = make_zero<F>();
-			for (size_t j = 0; j < matrix.m(); ++j) {
-				sum += vector[j] * matrix(j, i);
-			}
-			result[i] = sum;
+		// sum of the rows scaled by the vector
+		for (size_t j = 0; j < matrix.m(); ++j) {
+			kernels::add_scaled(result.values().data(), matrix.row(j).data(), vector[j], matrix.n());
 		}
 
 		return result;
@@ -688,13 +807,13 @@ namespace lingebra {
 			b[h] *= global_f;
 
 			// eliminate
+			const F *pivot_row = matrix.row(h).data() + k + 1;
+
 			for (size_t i = 0; i < m; ++i) {
 				if (i == h) continue;
 				F local_f = matrix(i, k);
 				matrix(i, k) = make_zero<F>();
-				for (size_t j = k + 1; j < n; ++j) {
-					matrix(i, j) -= matrix(h, j) * local_f;
-				}
+				kernels::sub_scaled(matrix.row(i).data() + k + 1, pivot_row, local_f, n - k - 1);
 				b[i] -= b[h] * local_f;
 			}
 
@@ -703,6 +822,813 @@ namespace lingebra {
 		}
 	}
 
+	/* LU factorization of a dense square matrix with partial pivoting, PA = LU.
+	 * Factorizing costs O(n^3), every following solve with a new right hand side only O(n^2). */
+	template <field F>
+	class DenseLU {
+	public:
+		using value_type = F;
+
+	private:
+		// L (below the diagonal, unit diagonal implied) and U (on and above the diagonal)
+		Matrix<F> lu;
+
+		// row_perm[i] is the row of the original matrix that ended up on the i-th row
+		std::vector<size_t> row_perm;
+
+	public:
+		DenseLU() = default;
+		explicit DenseLU(const Matrix<F> &matrix) {
+			factorize(matrix);
+		}
+
+		// throws singular_matrix_exception if the matrix is singular
+		void factorize(const Matrix<F> &matrix) {
+			if (!matrix.is_square()) {
+				throw std::runtime_error("DenseLU requires a square matrix");
+			}
+
+			const size_t n = matrix.n();
+
+			lu = matrix;
+			row_perm.resize(n);
+			for (size_t i = 0; i < n; ++i) row_perm[i] = i;
+
+			for (size_t k = 0; k < n; ++k) {
+				// find k-th pivot
+				size_t i_max = k;
+				for (size_t i = k + 1; i < n; ++i) {
+					if (abs(lu(i, k)) > abs(lu(i_max, k))) i_max = i;
+				}
+				if (is_zero(lu(i_max, k))) {
+					// no pivot in column => singular matrix
+					throw singular_matrix_exception();
+				}
+
+				if (i_max != k) {
+					lu.swap_rows(k, i_max);
+					std::swap(row_perm[k], row_perm[i_max]);
+				}
+
+				const F pivot_inv = make_one<F>() / lu(k, k);
+
+				// eliminate, the multipliers are stored in place of the eliminated entries
+				const F *pivot_row = lu.row(k).data() + k + 1;
+
+				for (size_t i = k + 1; i < n; ++i) {
+					const F f = lu(i, k) * pivot_inv;
+					lu(i, k) = f;
+					if (is_zero(f)) continue;
+					kernels::sub_scaled(lu.row(i).data() + k + 1, pivot_row, f, n - k - 1);
+				}
+			}
+		}
+
+		constexpr size_t dim() const noexcept {
+			return row_perm.size();
+		}
+
+		// Solves Ax = b in place, b is overwritten by x.
+		void solve(Vector<F> &b) const {
+			const size_t n = dim();
+			if (b.dim() != n) {
+				throw std::runtime_error("Size mismatch in DenseLU::solve");
+			}
+
+			Vector<F> x(n);
+			for (size_t i = 0; i < n; ++i) {
+				x[i] = b[row_perm[i]];
+			}
+
+			const F *xs = x.values().data();
+
+			// forward substitution with the unit lower triangle
+			for (size_t i = 0; i < n; ++i) {
+				x[i] -= kernels::dot(lu.row(i).data(), xs, i, make_zero<F>());
+			}
+
+			// back substitution with the upper triangle
+			for (size_t i = n; i-- > 0;) {
+				F sum = x[i] - kernels::dot(lu.row(i).data() + i + 1, xs + i + 1, n - i - 1, make_zero<F>());
+				x[i] = sum / lu(i, i);
+			}
+
+			b = std::move(x);
+		}
+	};
+
+
+	// A sparse matrix in the compressed sparse column (CSC) format
+	template <field F>
+	class SparseMatrix {
+	public:
+		using value_type = F;
+
+	private:
+		size_t num_rows, num_cols;
+
+		// column j has its entries at positions col_starts[j] .. col_starts[j + 1] - 1,
+		// sorted by the row index
+		std::vector<size_t> col_starts;
+		std::vector<size_t> row_ids;
+		std::vector<F> data;
+
+		static constexpr F zero = make_zero<F>();
+
+	public:
+		constexpr SparseMatrix() noexcept : num_rows(0), num_cols(0), col_starts(1, 0) {}
+		constexpr SparseMatrix(size_t m, size_t n) : num_rows(m), num_cols(n), col_starts(n + 1, 0) {}
+		constexpr explicit SparseMatrix(const Matrix<F> &dense) : SparseMatrix(dense.m(), dense.n()) {
+			for (size_t j = 0; j < num_cols; ++j) {
+				for (size_t i = 0; i < num_rows; ++i) {
+					if (is_zero(dense(i, j))) continue;
+					row_ids.push_back(i);
+					data.push_back(dense(i, j));
+				}
+				col_starts[j + 1] = row_ids.size();
+			}
+		}
+
+		constexpr SparseMatrix(const SparseMatrix &) = default;
+		constexpr SparseMatrix(SparseMatrix &&) noexcept = default;
+		constexpr SparseMatrix &operator=(const SparseMatrix &) = default;
+		constexpr SparseMatrix &operator=(SparseMatrix &&) noexcept = default;
+
+		~SparseMatrix() = default;
+
+
+		// Builds the structure of the matrix with all values zero from the positions [(row, column), ...],
+		// positions can repeat. value_ids[i] is set to the index into values() of positions[i].
+		static SparseMatrix from_pattern(size_t m, size_t n, std::span<const std::pair<size_t, size_t>> positions, std::vector<size_t> &value_ids) {
+			SparseMatrix mat(m, n);
+
+			// count the entries in every column
+			for (const auto &[row, col] : positions) {
+				if (row >= m || col >= n) {
+					throw std::out_of_range(std::format("Position ({}, {}) is out of the {}x{} matrix", row, col, m, n));
+				}
+				++mat.col_starts[col + 1];
+			}
+			for (size_t j = 0; j < n; ++j) {
+				mat.col_starts[j + 1] += mat.col_starts[j];
+			}
+
+			// bucket the positions by columns
+			std::vector<size_t> next(mat.col_starts.begin(), mat.col_starts.end() - 1);
+			std::vector<size_t> order(positions.size());
+
+			for (size_t i = 0; i < positions.size(); ++i) {
+				order[next[positions[i].second]++] = i;
+			}
+
+			// sort every column by rows and merge the duplicates
+			value_ids.resize(positions.size());
+			size_t nnz = 0;
+
+			for (size_t j = 0; j < n; ++j) {
+				const auto first = order.begin() + mat.col_starts[j];
+				const auto last = order.begin() + mat.col_starts[j + 1];
+				std::sort(first, last, [&](size_t a, size_t b) { return positions[a].first < positions[b].first; });
+
+				mat.col_starts[j] = nnz;
+
+				for (auto it = first; it != last; ++it) {
+					const size_t row = positions[*it].first;
+					if (nnz == mat.col_starts[j] || mat.row_ids[nnz - 1] != row) {
+						mat.row_ids.push_back(row);
+						++nnz;
+					}
+					value_ids[*it] = nnz - 1;
+				}
+			}
+			mat.col_starts[n] = nnz;
+			mat.data.assign(nnz, zero);
+
+			return mat;
+		}
+
+		// a matrix of the same structure as other with all values zero
+		template <field G>
+		static SparseMatrix with_structure_of(const SparseMatrix<G> &other) {
+			SparseMatrix mat(other.m(), other.n());
+			mat.col_starts = other.col_starts_array();
+			mat.row_ids = other.row_ids_array();
+			mat.data.assign(other.nnz(), zero);
+			return mat;
+		}
+
+		// Builds the matrix from [(row, column, value), ...], values on the same position are summed
+		static SparseMatrix from_triplets(size_t m, size_t n, const std::vector<std::tuple<size_t, size_t, F>> &triplets) {
+			std::vector<std::pair<size_t, size_t>> positions;
+			positions.reserve(triplets.size());
+			for (const auto &[row, col, value] : triplets) {
+				positions.push_back({ row, col });
+			}
+
+			std::vector<size_t> value_ids;
+			SparseMatrix mat = from_pattern(m, n, positions, value_ids);
+
+			for (size_t i = 0; i < triplets.size(); ++i) {
+				mat.data[value_ids[i]] += std::get<2>(triplets[i]);
+			}
+
+			return mat;
+		}
+
+
+		constexpr size_t m() const noexcept {
+			return num_rows;
+		}
+
+		constexpr size_t n() const noexcept {
+			return num_cols;
+		}
+
+		// number of stored entries
+		constexpr size_t nnz() const noexcept {
+			return data.size();
+		}
+
+		constexpr bool is_square() const noexcept {
+			return num_rows == num_cols;
+		}
+
+		constexpr const std::vector<size_t> &col_starts_array() const noexcept {
+			return col_starts;
+		}
+
+		constexpr const std::vector<size_t> &row_ids_array() const noexcept {
+			return row_ids;
+		}
+
+		constexpr std::vector<F> &values() noexcept {
+			return data;
+		}
+
+		constexpr const std::vector<F> &values() const noexcept {
+			return data;
+		}
+
+		// O(log(nnz in the column)) lookup, returns zero for entries that are not stored
+		constexpr F operator()(size_t row, size_t col) const {
+			auto first = row_ids.begin() + col_starts[col];
+			auto last = row_ids.begin() + col_starts[col + 1];
+			auto it = std::lower_bound(first, last, row);
+			if (it == last || *it != row) return zero;
+			return data[it - row_ids.begin()];
+		}
+
+		constexpr Matrix<F> to_dense() const {
+			Matrix<F> dense(num_rows, num_cols);
+			for (size_t j = 0; j < num_cols; ++j) {
+				for (size_t p = col_starts[j]; p < col_starts[j + 1]; ++p) {
+					dense(row_ids[p], j) += data[p];
+				}
+			}
+			return dense;
+		}
+
+		constexpr std::string repr() const {
+			return to_dense().repr();
+		}
+	};
+
+
+	template <field F>
+	Vector<F> operator*(const SparseMatrix<F> &matrix, const Vector<F> &vector) {
+		if (matrix.n() != vector.dim()) {
+			throw std::runtime_error("Uncompatible matrix, vector size");
+		}
+
+		const auto &col_starts = matrix.col_starts_array();
+		const auto &row_ids = matrix.row_ids_array();
+		const auto &values = matrix.values();
+
+		Vector<F> result(matrix.m());
+
+		for (size_t j = 0; j < matrix.n(); ++j) {
+			for (size_t p = col_starts[j]; p < col_starts[j + 1]; ++p) {
+				result[row_ids[p]] += values[p] * vector[j];
+			}
+		}
+
+		return result;
+	}
+
+
+	/* Graph of the symmetric pattern of A + A^T without the diagonal, as used to predict the fill
+	 * of the factorization. Eliminating a vertex connects all its neighbours to each other,
+	 * the new edges are exactly the fill-in the elimination causes. */
+	class EliminationGraph {
+	private:
+		// sorted neighbours of every vertex not eliminated yet
+		std::vector<std::vector<size_t>> adjacency;
+		std::vector<bool> eliminated;
+
+	public:
+		template <field F>
+		explicit EliminationGraph(const SparseMatrix<F> &matrix) : adjacency(matrix.n()), eliminated(matrix.n(), false) {
+			if (!matrix.is_square()) {
+				throw std::runtime_error("EliminationGraph requires a square matrix");
+			}
+
+			const auto &col_starts = matrix.col_starts_array();
+			const auto &row_ids = matrix.row_ids_array();
+
+			for (size_t j = 0; j < matrix.n(); ++j) {
+				for (size_t p = col_starts[j]; p < col_starts[j + 1]; ++p) {
+					const size_t i = row_ids[p];
+					if (i == j) continue;
+					adjacency[i].push_back(j);
+					adjacency[j].push_back(i);
+				}
+			}
+
+			for (auto &neighbours : adjacency) {
+				std::sort(neighbours.begin(), neighbours.end());
+				neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			}
+		}
+
+		size_t size() const noexcept {
+			return adjacency.size();
+		}
+
+		size_t degree(size_t v) const noexcept {
+			return adjacency[v].size();
+		}
+
+		bool is_eliminated(size_t v) const noexcept {
+			return eliminated[v];
+		}
+
+		// Eliminates the vertex v, returns its neighbours at the elimination
+		std::vector<size_t> eliminate(size_t v) {
+			std::vector<size_t> clique = std::move(adjacency[v]);
+			adjacency[v].clear();
+			eliminated[v] = true;
+
+			std::vector<size_t> merged;
+
+			for (size_t u : clique) {
+				merged.clear();
+				merged.reserve(adjacency[u].size() + clique.size());
+				std::set_union(adjacency[u].begin(), adjacency[u].end(), clique.begin(), clique.end(), std::back_inserter(merged));
+				std::erase_if(merged, [&](size_t w) { return w == u || w == v; });
+				adjacency[u].swap(merged);
+			}
+
+			return clique;
+		}
+	};
+
+	// Fill-reducing order of the columns with the predicted fill of the factorization
+	struct FillReducingOrder {
+		std::vector<size_t> order;
+		// predicted number of the stored entries in L and U (both diagonals included),
+		// exact as long as the pivots stay on the diagonal
+		size_t predicted_nnz = 0;
+	};
+
+	// Predicted number of the stored entries in L and U if the columns are eliminated in the given order
+	template <field F>
+	size_t predict_lu_nnz(const SparseMatrix<F> &matrix, const std::vector<size_t> &order) {
+		EliminationGraph graph(matrix);
+
+		size_t nnz = 2 * graph.size();
+		for (size_t v : order) {
+			nnz += 2 * graph.eliminate(v).size();
+		}
+
+		return nnz;
+	}
+
+	/* Minimum degree ordering on the symmetric pattern of A + A^T. Eliminates the vertex with the
+	 * fewest neighbours on every step, ties broken by the lower index. Computed on the explicit
+	 * elimination graph, which is cheap as long as the fill stays low, which is the point. */
+	template <field F>
+	FillReducingOrder minimum_degree_order(const SparseMatrix<F> &matrix) {
+		EliminationGraph graph(matrix);
+		const size_t n = graph.size();
+
+		FillReducingOrder result;
+		result.order.reserve(n);
+		result.predicted_nnz = 2 * n;
+
+		// (degree, vertex), entries with an outdated degree are skipped
+		using Entry = std::pair<size_t, size_t>;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+		for (size_t v = 0; v < n; ++v) {
+			queue.push({ graph.degree(v), v });
+		}
+
+		while (!queue.empty()) {
+			const auto [degree, v] = queue.top();
+			queue.pop();
+
+			if (graph.is_eliminated(v) || degree != graph.degree(v)) continue;
+
+			const std::vector<size_t> clique = graph.eliminate(v);
+
+			result.order.push_back(v);
+			result.predicted_nnz += 2 * clique.size();
+
+			for (size_t u : clique) {
+				queue.push({ graph.degree(u), u });
+			}
+		}
+
+		return result;
+	}
+
+
+	/* LU factorization of a sparse square matrix with partial pivoting, PAQ = LU.
+	 * Uses the left-looking Gilbert-Peierls algorithm: every column of L and U is computed
+	 * by a sparse triangular solve, so the cost is proportional to the number of
+	 * floating point operations instead of n^3. The column order Q is set by the caller,
+	 * see minimum_degree_order. */
+	template <field F>
+	class SparseLU {
+	public:
+		using value_type = F;
+
+	private:
+		static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+		// for floating point matrices the diagonal entry is preferred as the pivot
+		// if it is at least this fraction of the largest candidate, it keeps the fill low
+		static constexpr double diagonal_pivot_tolerance = 0.1;
+
+		size_t size = 0;
+
+		// L is unit lower triangular, the first entry of every column is the unit diagonal
+		std::vector<size_t> l_col_starts;
+		std::vector<size_t> l_row_ids;
+		std::vector<F> l_data;
+
+		// U is upper triangular, the last entry of every column is the diagonal
+		std::vector<size_t> u_col_starts;
+		std::vector<size_t> u_row_ids;
+		std::vector<F> u_data;
+
+		// row_perm[i] is the pivot step at which the row i was eliminated
+		std::vector<size_t> row_perm;
+
+		// col_order[k] is the column of the matrix factorized at the step k, empty for the natural order
+		std::vector<size_t> col_order;
+
+		// workspace of solve()
+		mutable std::vector<F> work;
+
+		// Computes the nonzero pattern of x in Lx = A(:, col), the pattern is returned
+		// in topological order in stack[top .. size - 1]. Rows not yet pivoted have no
+		// column in L and end the search.
+		size_t reach(const SparseMatrix<F> &matrix, size_t col, std::vector<size_t> &stack, std::vector<size_t> &path, std::vector<size_t> &path_pos, std::vector<bool> &marked) const {
+			const auto &col_starts = matrix.col_starts_array();
+			const auto &row_ids = matrix.row_ids_array();
+
+			size_t top = size;
+
+			for (size_t p = col_starts[col]; p < col_starts[col + 1]; ++p) {
+				if (marked[row_ids[p]]) continue;
+
+				// iterative depth first search from row_ids[p]
+				size_t depth = 0;
+				path[0] = row_ids[p];
+
+				while (true) {
+					const size_t i = path[depth];
+					const size_t j = row_perm[i];
+
+					if (!marked[i]) {
+						marked[i] = true;
+						path_pos[depth] = (j == none) ? 0 : l_col_starts[j] + 1;
+					}
+
+					bool descended = false;
+
+					if (j != none) {
+						for (size_t &q = path_pos[depth]; q < l_col_starts[j + 1]; ++q) {
+							if (marked[l_row_ids[q]]) continue;
+							path[++depth] = l_row_ids[q];
+							++q;
+							descended = true;
+							break;
+						}
+					}
+
+					if (descended) continue;
+
+					stack[--top] = i;
+					if (depth == 0) break;
+					--depth;
+				}
+			}
+
+			for (size_t p = top; p < size; ++p) marked[stack[p]] = false;
+
+			return top;
+		}
+
+	public:
+		SparseLU() = default;
+		explicit SparseLU(const SparseMatrix<F> &matrix) {
+			factorize(matrix);
+		}
+
+		// Factorizes the columns in the given order from now on, the row order still comes from
+		// the pivoting, which prefers the row order[k] at the step k. An empty order is the natural one.
+		void set_column_order(std::vector<size_t> order) {
+			col_order = std::move(order);
+		}
+
+		const std::vector<size_t> &get_column_order() const noexcept {
+			return col_order;
+		}
+
+		// throws singular_matrix_exception if the matrix is singular
+		void factorize(const SparseMatrix<F> &matrix) {
+			if (!matrix.is_square()) {
+				throw std::runtime_error("SparseLU requires a square matrix");
+			}
+			if (!col_order.empty() && col_order.size() != matrix.n()) {
+				throw std::runtime_error("The column order of SparseLU does not match the matrix");
+			}
+
+			size = matrix.n();
+
+			const auto &col_starts = matrix.col_starts_array();
+			const auto &row_ids = matrix.row_ids_array();
+			const auto &values = matrix.values();
+
+			l_col_starts.assign(1, 0);
+			l_row_ids.clear();
+			l_data.clear();
+			u_col_starts.assign(1, 0);
+			u_row_ids.clear();
+			u_data.clear();
+
+			l_row_ids.reserve(matrix.nnz() + size);
+			l_data.reserve(matrix.nnz() + size);
+			u_row_ids.reserve(matrix.nnz() + size);
+			u_data.reserve(matrix.nnz() + size);
+
+			row_perm.assign(size, none);
+
+			std::vector<F> x(size, make_zero<F>());
+			std::vector<size_t> stack(size), path(size), path_pos(size);
+			std::vector<bool> marked(size, false);
+
+			for (size_t k = 0; k < size; ++k) {
+				const size_t col = col_order.empty() ? k : col_order[k];
+
+				// x = L \ A(:, col), only on the reachable pattern
+				const size_t top = reach(matrix, col, stack, path, path_pos, marked);
+
+				for (size_t p = col_starts[col]; p < col_starts[col + 1]; ++p) {
+					x[row_ids[p]] = values[p];
+				}
+
+				for (size_t p = top; p < size; ++p) {
+					const size_t i = stack[p];
+					const size_t j = row_perm[i];
+					if (j == none) continue;
+
+					const F xi = x[i];
+					for (size_t q = l_col_starts[j] + 1; q < l_col_starts[j + 1]; ++q) {
+						x[l_row_ids[q]] -= l_data[q] * xi;
+					}
+				}
+
+				// split x into the k-th column of U and the candidates for the pivot
+				size_t pivot_row = none;
+
+				for (size_t p = top; p < size; ++p) {
+					const size_t i = stack[p];
+
+					if (row_perm[i] != none) {
+						u_row_ids.push_back(row_perm[i]);
+						u_data.push_back(x[i]);
+					}
+					else if (!is_zero(x[i]) && (pivot_row == none || abs(x[i]) > abs(x[pivot_row]))) {
+						pivot_row = i;
+					}
+				}
+
+				if (pivot_row == none) {
+					// no pivot in column => singular matrix
+					for (size_t p = top; p < size; ++p) x[stack[p]] = make_zero<F>();
+					throw singular_matrix_exception();
+				}
+
+				if constexpr (std::floating_point<F>) {
+					if (row_perm[col] == none && !is_zero(x[col]) && abs(x[col]) >= abs(x[pivot_row]) * static_cast<F>(diagonal_pivot_tolerance)) {
+						pivot_row = col;
+					}
+				}
+
+				const F pivot = x[pivot_row];
+				const F pivot_inv = make_one<F>() / pivot;
+
+				u_row_ids.push_back(k);
+				u_data.push_back(pivot);
+				u_col_starts.push_back(u_row_ids.size());
+
+				row_perm[pivot_row] = k;
+				l_row_ids.push_back(pivot_row);
+				l_data.push_back(make_one<F>());
+
+				for (size_t p = top; p < size; ++p) {
+					const size_t i = stack[p];
+					if (row_perm[i] == none) {
+						l_row_ids.push_back(i);
+						l_data.push_back(x[i] * pivot_inv);
+					}
+					x[i] = make_zero<F>();
+				}
+				l_col_starts.push_back(l_row_ids.size());
+			}
+
+			// renumber the rows of L to the pivot order
+			for (size_t &i : l_row_ids) i = row_perm[i];
+
+			work.assign(size, make_zero<F>());
+		}
+
+		constexpr size_t dim() const noexcept {
+			return size;
+		}
+
+		// number of stored entries in L and U, including the unit diagonal of L
+		constexpr size_t nnz() const noexcept {
+			return l_data.size() + u_data.size();
+		}
+
+		// approximate heap memory held by the factorization
+		constexpr size_t memory_bytes() const noexcept {
+			const size_t num_ids = l_col_starts.size() + l_row_ids.size() + u_col_starts.size() + u_row_ids.size() + row_perm.size() + col_order.size();
+			return num_ids * sizeof(size_t) + (nnz() + work.size()) * sizeof(F);
+		}
+
+		// Solves Ax = b in place, b is overwritten by x.
+		void solve(std::span<F> b) const {
+			if (b.size() != size) {
+				throw std::runtime_error("Size mismatch in SparseLU::solve");
+			}
+
+			// work = Pb
+			for (size_t i = 0; i < size; ++i) {
+				work[row_perm[i]] = b[i];
+			}
+
+			// work = L \ work
+			for (size_t j = 0; j < size; ++j) {
+				const F xj = work[j];
+				for (size_t p = l_col_starts[j] + 1; p < l_col_starts[j + 1]; ++p) {
+					work[l_row_ids[p]] -= l_data[p] * xj;
+				}
+			}
+
+			// work = U \ work
+			for (size_t j = size; j-- > 0;) {
+				const size_t diag = u_col_starts[j + 1] - 1;
+				work[j] /= u_data[diag];
+				const F xj = work[j];
+				for (size_t p = u_col_starts[j]; p < diag; ++p) {
+					work[u_row_ids[p]] -= u_data[p] * xj;
+				}
+			}
+
+			// undo the column order
+			for (size_t k = 0; k < size; ++k) {
+				b[col_order.empty() ? k : col_order[k]] = work[k];
+			}
+		}
+
+		void solve(Vector<F> &b) const {
+			if (b.dim() != size) {
+				throw std::runtime_error("Size mismatch in SparseLU::solve");
+			}
+			if (size != 0) solve(std::span<F>(&b[0], size));
+		}
+	};
+
+
+	/* Solves (A + sum_k d_k e_{i_k} e_{i_k}^T) x = b, A with some diagonal entries changed, using
+	 * the factorization of A and the Woodbury identity
+	 *   (A + E D E^T)^-1 = A^-1 - Z (I + D E^T Z)^-1 D E^T A^-1,  Z = A^-1 E.
+	 * The columns of Z are computed once per row and kept until the base changes, so changing
+	 * the set of updates costs only the dense r x r factorization of I + D E^T Z. */
+	template <field F>
+	class DiagonalUpdate {
+	public:
+		using value_type = F;
+
+	private:
+		const SparseLU<F> *base = nullptr;
+
+		// updated rows and the values added to their diagonal entries
+		std::vector<size_t> rows;
+		std::vector<F> deltas;
+
+		// columns of A^-1 e_i by the row i, valid while the base factorization does not change
+		std::vector<std::vector<F>> inverse_columns;
+		std::vector<size_t> column_ids;
+
+		static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+		// I + D E^T Z
+		DenseLU<F> capacitance;
+		mutable Vector<F> small_rhs;
+
+		const std::vector<F> &inverse_column(size_t row) {
+			if (column_ids[row] == none) {
+				std::vector<F> column(base->dim(), make_zero<F>());
+				column[row] = make_one<F>();
+				base->solve(std::span<F>(column));
+
+				column_ids[row] = inverse_columns.size();
+				inverse_columns.push_back(std::move(column));
+			}
+
+			return inverse_columns[column_ids[row]];
+		}
+
+	public:
+		DiagonalUpdate() = default;
+
+		// Uses the given factorization as A, removes all the updates.
+		// Call again whenever the factorization changes.
+		void reset(const SparseLU<F> &base) {
+			this->base = &base;
+			rows.clear();
+			deltas.clear();
+			inverse_columns.clear();
+			column_ids.assign(base.dim(), none);
+		}
+
+		// Replaces the updates by [(row, value added to the diagonal entry), ...], rows must not repeat.
+		// throws singular_matrix_exception if the updated matrix is singular
+		void set(std::span<const std::pair<size_t, F>> updates) {
+			if (base == nullptr) {
+				throw std::runtime_error("DiagonalUpdate::set requires a base factorization");
+			}
+
+			rows.clear();
+			deltas.clear();
+
+			for (const auto &[row, delta] : updates) {
+				if (row >= base->dim()) {
+					throw std::out_of_range(std::format("Row {} is out of the {}x{} matrix", row, base->dim(), base->dim()));
+				}
+				rows.push_back(row);
+				deltas.push_back(delta);
+			}
+
+			const size_t r = rows.size();
+			small_rhs.assign(r);
+			if (r == 0) return;
+
+			Matrix<F> S(r, r);
+			for (size_t k = 0; k < r; ++k) {
+				// column k of D E^T Z is d * (A^-1 e_{i_k}) restricted to the updated rows
+				const std::vector<F> &column = inverse_column(rows[k]);
+				for (size_t l = 0; l < r; ++l) {
+					S(l, k) = deltas[l] * column[rows[l]];
+				}
+				S(k, k) += make_one<F>();
+			}
+
+			capacitance.factorize(S);
+		}
+
+		constexpr size_t rank() const noexcept {
+			return rows.size();
+		}
+
+		// Solves the updated system in place, b is overwritten by x.
+		void solve(std::span<F> b) const {
+			base->solve(b);
+
+			const size_t r = rows.size();
+			if (r == 0) return;
+
+			// t = (I + D E^T Z)^-1 D E^T A^-1 b
+			for (size_t k = 0; k < r; ++k) {
+				small_rhs[k] = deltas[k] * b[rows[k]];
+			}
+			capacitance.solve(small_rhs);
+
+			// x = A^-1 b - Z t
+			for (size_t k = 0; k < r; ++k) {
+				const std::vector<F> &column = inverse_columns[column_ids[rows[k]]];
+				kernels::sub_scaled(b.data(), column.data(), small_rhs[k], b.size());
+			}
+		}
+	};
+
+
 	// type traits and concepts for vectors and matrices
 	template <class T> struct is_Vector : std::false_type {};
 	template <class T> struct is_Vector<Vector<T>> : std::true_type {};
@@ -9,6 +9,8 @@
 #include "circuit/parts/switch.h"
 #include "circuit/parts/voltage_source.h"
 #include "circuit/scalar.h"
+#include "circuit/stream.h"
+#include "circuit/table_file.h"
 
 
 
@@ -17,14 +19,57 @@ int main(int argc, char *argv[]) {
 	Settings settings = handle_args(argc, argv);
 	if (settings.exit) return settings.exit_code;
 
+	if (!settings.convert_path.empty()) {
+		try {
+			fs::path csv_path = settings.convert_path;
+			csv_path.replace_extension(".csv");
+
+			TableReader table(settings.convert_path);
+			table.write_csv(csv_path);
+			std::cout << "Converted " << table.get_num_columns() << " columns of " << table.get_num_samples() << " samples to " << csv_path << "\n";
+		}
+		catch (const std::exception &e) {
+			std::cerr << e.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	// the samples go to the standard output, the messages to the error output
+	if (settings.stream_path == "-") std::cout.rdbuf(std::cerr.rdbuf());
+
 
-	Circuit circuit(1e-5, settings.tables_path);
+	Circuit circuit(1.0 / (settings.samplerate * settings.oversampling), settings.tables_path);
+	circuit.set_oversampling(settings.oversampling);
+	circuit.set_factorization_cache_budget(static_cast<size_t>(settings.factorization_cache_mib * 1024 * 1024));
+	circuit.set_stream_tables(settings.stream_tables);
+	circuit.set_table_format(settings.table_format);
 
 	try {
 		circuit.load_circuit(settings.circuit_path);
+		circuit.compile();
 	}
 	catch (const std::exception &e) {
 		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	if (!settings.stream_path.empty()) {
+		try {
+			PcmFileSink sink(settings.stream_path, settings.stream_format);
+			AudioStream stream(circuit, sink, settings.stream);
+
+			std::cout << "Streaming " << stream.get_channels() << " channels at " << circuit.get_samplerate() << " Hz\n";
+			stream.run_for_seconds(settings.duration);
+
+			const StreamStats &stats = stream.get_stats();
+			std::cout << "Streamed " << stats.frames_written << " frames, " << stats.underruns << " underruns (" << stats.silent_frames << " silent frames)\n";
+		}
+		catch (const std::exception &e) {
+			std::cerr << e.what() << "\n";
+			return 1;
+		}
+		return 0;
 	}
 
 	circuit.run_for_seconds(settings.duration);
@@ -52,7 +97,9 @@ int main(int argc, char *argv[]) {
 	//circuit.scope_voltage(C1->pin(0), C1->pin(1));
 	//circuit.scope_current(C1);
 
-	//S1->schedule_on(100_m / circuit.get_timestep());
+	//S1->schedule_on(100_m);
+
+	//circuit.compile();
 
 	//std::cout << "Node Count: " << circuit.get_nodes().size() << "\n";
 	//std::cout << "Part Count: " << circuit.get_parts().size() << "\n";
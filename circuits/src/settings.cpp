@@ -26,8 +26,30 @@ static void print_help() {
 		<< "  -h, --help			    Show this help message\n"
 		<< "  -r, --samplerate <freq>   Sets the samplerate in Hz\n"
 		<< "                            (default: 44100)\n"
+		<< "  -o, --oversampling <factor>\n"
+		<< "                            Runs the circuit at factor times the samplerate\n"
+		<< "                            and decimates the tables to the samplerate\n"
+		<< "                            (default: 4)\n"
 		<< "  -e, --export-tables       Exports the scope tables\n"
+		<< "  -w, --stream-tables       Writes the scope tables while running with\n"
+		<< "                            bounded memory, no graphs\n"
+		<< "  --table-format   <csv|binary>\n"
+		<< "                            Format of the exported tables, binary writes\n"
+		<< "                            all the scopes to one scopes.slt (default: csv)\n"
+		<< "  --convert        <table>  Converts a binary table to CSV next to it\n"
+		<< "                            and exits, takes no circuit\n"
 		<< "  -g, --show-graphs         Displays the scope graphs after run\n"
+		<< "  -c, --factorization-cache <MiB>\n"
+		<< "                            Memory for the matrix factorizations cached\n"
+		<< "                            by the switch states, 0 disables the cache\n"
+		<< "                            (default: 16)\n"
+		<< "  -s, --stream     <path>   Streams the scopes in real time as interleaved\n"
+		<< "                            raw PCM to a file or FIFO, - for stdout\n"
+		<< "  --stream-format  <f32|s16>\n"
+		<< "                            Sample format of the stream (default: f32)\n"
+		<< "  --buffer-frames  <frames> Ring buffer size, the latency (default: 4096)\n"
+		<< "  --period-frames  <frames> Frames written at once (default: 256)\n"
+		<< "  --unpaced                 Writes the stream as fast as it renders\n"
 		;
 }
 
@@ -57,6 +79,32 @@ Settings handle_args(int argc, char *argv[]) {
 		else if (accept_options && (option == "-e" || option == "--export-tables")) {
 			settings.export_tables = true;
 		}
+		else if (accept_options && (option == "-w" || option == "--stream-tables")) {
+			settings.stream_tables = true;
+		}
+		else if (accept_options && option == "--table-format") {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <csv|binary> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			std::string argument = argv[i];
+			if (argument == "csv") settings.table_format = TableFormat::csv;
+			else if (argument == "binary") settings.table_format = TableFormat::binary;
+			else {
+				std::cout << "Argument <csv|binary> must be csv or binary.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+		}
+		else if (accept_options && option == "--convert") {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <table> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			settings.convert_path = fs::path(argv[i]);
+		}
 		else if (accept_options && (option == "-g" || option == "--show_graphs")) {
 			settings.show_graphs = true;
 		}
@@ -89,6 +137,95 @@ Settings handle_args(int argc, char *argv[]) {
 				return Settings{ .exit = true, .exit_code = 2 };
 			}
 		}
+		else if (accept_options && (option == "-o" || option == "--oversampling")) {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <factor> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			try {
+				settings.oversampling = std::stoul(argv[i]);
+			}
+			catch (const std::exception &) {
+				std::cout << "Argument <factor> must be an integer in valid range.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			if (settings.oversampling == 0) {
+				std::cout << "Argument <factor> must be positive.\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+		}
+		else if (accept_options && (option == "-s" || option == "--stream")) {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <path> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			settings.stream_path = fs::path(argv[i]);
+		}
+		else if (accept_options && option == "--stream-format") {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <f32|s16> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			std::string argument = argv[i];
+			if (argument == "f32") settings.stream_format = PcmFormat::float32;
+			else if (argument == "s16") settings.stream_format = PcmFormat::int16;
+			else {
+				std::cout << "Argument <f32|s16> must be f32 or s16.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+		}
+		else if (accept_options && (option == "--buffer-frames" || option == "--period-frames")) {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <frames> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			size_t frames;
+			try {
+				frames = std::stoul(argv[i]);
+			}
+			catch (const std::exception &) {
+				std::cout << "Argument <frames> must be an integer in valid range.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			if (frames == 0) {
+				std::cout << "Argument <frames> must be positive.\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			if (option == "--buffer-frames") settings.stream.buffer_frames = frames;
+			else settings.stream.period_frames = frames;
+		}
+		else if (accept_options && option == "--unpaced") {
+			settings.stream.paced = false;
+		}
+		else if (accept_options && (option == "-c" || option == "--factorization-cache")) {
+			if (++i >= argc) {
+				std::cout << "Option " << option << " requires <MiB> argument.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			try {
+				settings.factorization_cache_mib = std::stof(argv[i]);
+			}
+			catch (const std::exception &) {
+				std::cout << "Argument <MiB> must be a floating point number in valid range.\nSee help:\n\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+			if (settings.factorization_cache_mib < 0.0) {
+				std::cout << "Argument <MiB> must not be negative.\n";
+				print_help();
+				return Settings{ .exit = true, .exit_code = 2 };
+			}
+		}
 		else {
 			if (pos_idx == 0) {
 				settings.circuit_path = option;
@@ -118,12 +255,25 @@ Settings handle_args(int argc, char *argv[]) {
 		}
 	}
 
+	if (settings.convert_path != "" && !do_print_help && !do_print_version) {
+		return settings;
+	}
+
 	if (settings.circuit_path == "") {
 		std::cout << "SimLogue requires the circuit file path.\nSee help:\n\n";
 		print_help();
 		return Settings{ .exit = true, .exit_code = 2 };
 	}
 
+	if (settings.stream_tables && settings.show_graphs) {
+		std::cout << "The graphs need the recorded tables, -g can't be used with -w.\n";
+		return Settings{ .exit = true, .exit_code = 2 };
+	}
+	if (settings.stream_tables && settings.table_format == TableFormat::binary) {
+		std::cout << "The binary table is written after the run, --table-format binary can't be used with -w.\n";
+		return Settings{ .exit = true, .exit_code = 2 };
+	}
+
 	if (do_print_help) {
 		print_help();
 		return Settings{ .exit = true, .exit_code = 0 };
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "circuit/scalar.h"
+#include "circuit/stream.h"
+#include "circuit/table_file.h"
 #include <filesystem>
 
 
@@ -16,9 +18,22 @@ struct Settings {
 	int exit_code = 0;
 	fs::path tables_path = fs::path("./tables/");
 	scalar samplerate = 44100.0;
+	// the circuit runs at samplerate * oversampling, the tables are decimated to samplerate
+	size_t oversampling = 4;
 	fs::path circuit_path = fs::path("");
 	bool export_tables = false;
+	// writes the tables while running with bounded memory instead of exporting them after the run
+	bool stream_tables = false;
+	TableFormat table_format = TableFormat::csv;
+	// converts the binary table to a CSV instead of running a circuit when set
+	fs::path convert_path = fs::path("");
 	bool show_graphs = false;
+	// memory budget of the cached factorizations in MiB, 0 disables the cache
+	scalar factorization_cache_mib = 16.0;
+	// streams the scopes as raw PCM instead of running offline when set, "-" is the standard output
+	fs::path stream_path = fs::path("");
+	PcmFormat stream_format = PcmFormat::float32;
+	StreamSettings stream;
 };
 
 Settings handle_args(int argc, char *argv[]);
\ No newline at end of file